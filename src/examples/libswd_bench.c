@@ -0,0 +1,103 @@
+/*
+ * Serial Wire Debug Open Library.
+ * Host Image Routines Benchmark.
+ *
+ * Copyright (C) 2013, Tomasz Boleslaw CEDRO (http://www.tomek.cedro.info)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the Tomasz Boleslaw CEDRO nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Written by Tomasz Boleslaw CEDRO <cederom@tlen.pl>, 2013;
+ *
+ */
+
+/*
+ * Throughput of the host side image routines used by the verify paths:
+ * libswd_bin_crc32(), libswd_bin_compare() and libswd_bin_bswap32().
+ * SIMD paths are selected at compile time, so build both the library and
+ * this program with the same flags, for example:
+ *  ./configure CFLAGS="-O2 -march=native" && make
+ *  cc -O2 -march=native -I src src/examples/libswd_bench.c src/.libs/libswd.a -lpthread
+ * Usage: libswd_bench [megabytes] [rounds]
+ */
+
+#include <libswd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+double bench_now(void){
+ struct timespec ts;
+ clock_gettime(CLOCK_MONOTONIC, &ts);
+ return ts.tv_sec+ts.tv_nsec/1e9;
+}
+
+void bench_report(const char *name, double bytes, double seconds){
+ printf("%-24s %8.2f GB/s\n", name, bytes/seconds/1e9);
+}
+
+int main(int argc, char **argv){
+ int i, r, size, rounds, res=0;
+ unsigned int crc=0;
+ char *a, *b;
+ double t;
+
+ size=((argc>1)?atoi(argv[1]):64)*1024*1024;
+ rounds=(argc>2)?atoi(argv[2]):8;
+ if (size<=0 || rounds<=0){
+  printf("Usage: %s [megabytes] [rounds]\n", argv[0]);
+  return -1;
+ }
+ a=(char*)malloc(size);
+ b=(char*)malloc(size);
+ if (a==NULL || b==NULL){
+  printf("Cannot allocate %d bytes buffers!\n", size);
+  return -1;
+ }
+ srand(1);
+ for (i=0;i<size;i++) a[i]=rand();
+ memcpy(b, a, size);
+
+ printf("LibSWD host image routines, %d MB buffer, %d rounds:\n", size>>20, rounds);
+ t=bench_now();
+ for (r=0;r<rounds;r++) crc=libswd_bin_crc32(crc, a, size);
+ bench_report("libswd_bin_crc32()", (double)size*rounds, bench_now()-t);
+
+ t=bench_now();
+ for (r=0;r<rounds;r++) res+=(libswd_bin_compare(a, b, size)!=size);
+ bench_report("libswd_bin_compare()", (double)size*rounds, bench_now()-t);
+
+ t=bench_now();
+ for (r=0;r<rounds;r++) libswd_bin_bswap32(a, size/4);
+ bench_report("libswd_bin_bswap32()", (double)size*rounds, bench_now()-t);
+
+ // Even number of swaps gives the original buffer back.
+ if (rounds&1) libswd_bin_bswap32(a, size/4);
+ res+=memcmp(a, b, size)?1:0;
+ printf("CRC-32 0x%08X, %s.\n", crc, res?"FAILED":"OK");
+ free(a);
+ free(b);
+ return res;
+}
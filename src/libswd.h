@@ -176,6 +176,8 @@
 #define LIBSWD_DP_RDBUFF_ADDR    0xC
 /// ROUTESEL register address (WO)
 #define LIBSWD_DP_ROUTESEL_ADDR  0xC
+/// TARGETSEL register address (WO, SWDv2 multi-drop, ACK is not driven)
+#define LIBSWD_DP_TARGETSEL_ADDR 0xC
 
 /** SW-DP ABORT Register map */
 /// DAPABORT bit number.
@@ -264,6 +266,14 @@
 /// CSYSPWRUPACK bitmask
 #define LIBSWD_DP_CTRLSTAT_CSYSPWRUPACK         (1 << LIBSWD_DP_CTRLSTAT_CSYSPWRUPACK_BITNUM)
 
+/** SW-DP CTRLSTAT TRNMODE available values */
+/// Normal AP transfers.
+#define LIBSWD_TRNMODE_NORMAL          0b00
+/// AP write is compared with target value, STICKYCMP set on mismatch.
+#define LIBSWD_TRNMODE_PUSHEDVERIFY    0b01
+/// AP write is compared with target value, STICKYCMP set on match.
+#define LIBSWD_TRNMODE_PUSHEDCOMPARE   0b10
+
 /** SW-DP CTRLSTAT MASKLANE available values */
 /// Compare byte lane 0 (0x------FF)
 #define LIBSWD_MASKLANE_0 0b0001
@@ -273,6 +283,8 @@
 #define LIBSWD_MASKLANE_2 0b0100
 /// Compare byte lane 3 (0xFF------)
 #define LIBSWD_MASKLANE_3 0b1000
+/// Compare all byte lanes (0xFFFFFFFF)
+#define LIBSWD_MASKLANE_ALL 0b1111
 
 /** SW-DP SELECT Register map */
 /// CTRLSEL bit number.
@@ -364,6 +376,27 @@
 /// MEM-AP IDR register bank location.
 #define LIBSWD_MEMAP_IDR_APBANKSEL_VAL  0x0F
 
+/// Number of Access Ports addressable with DP SELECT APSEL field.
+#define LIBSWD_AP_COUNT                 256
+/// AP IDR TYPE field bitnumber.
+#define LIBSWD_AP_IDR_TYPE_BITNUM       0
+/// AP IDR CLASS field bitnumber.
+#define LIBSWD_AP_IDR_CLASS_BITNUM      13
+/// AP IDR TYPE field bitmask.
+#define LIBSWD_AP_IDR_TYPE              (0x0F << LIBSWD_AP_IDR_TYPE_BITNUM)
+/// AP IDR CLASS field bitmask.
+#define LIBSWD_AP_IDR_CLASS             (0x0F << LIBSWD_AP_IDR_CLASS_BITNUM)
+/// AP IDR CLASS value of the MEM-AP.
+#define LIBSWD_AP_IDR_CLASS_MEMAP_VAL   0x08
+/// AP IDR TYPE value of the JTAG-AP.
+#define LIBSWD_AP_IDR_TYPE_JTAG_VAL     0x00
+/// AP IDR TYPE value of the AMBA AHB MEM-AP.
+#define LIBSWD_AP_IDR_TYPE_AHB_VAL      0x01
+/// AP IDR TYPE value of the AMBA APB MEM-AP.
+#define LIBSWD_AP_IDR_TYPE_APB_VAL      0x02
+/// AP IDR TYPE value of the AMBA AXI MEM-AP.
+#define LIBSWD_AP_IDR_TYPE_AXI_VAL      0x04
+
 /// MEM-AP CSW DbgSwEnable bitnumer.
 #define LIBSWD_MEMAP_CSW_DBGSWENABLE_BITNUM 31
 /// MEM-AP CSW Prot bitnumber.
@@ -409,6 +442,8 @@
 #define LIBSWD_MEMAP_CFG_BIGENDIAN_BITNUM   0
 /// MEM-AP CFG Big-endian bitmask.
 #define LIBSWD_MEMAP_CFG_BIGENDIAN          (1 << LIBSWD_MEMAP_CFG_BIGENDIAN_BITNUM)
+/// DRW bit offset of the byte at given address, byte lanes follow target endianness (CFG BE).
+#define LIBSWD_MEMAP_LANE(libswdctx, addr) (8*(((addr)&3)^(((libswdctx)->log.memap.cfg&LIBSWD_MEMAP_CFG_BIGENDIAN)?3:0)))
 
 /// MEM-AP BASE BASEADDR bitnumber.
 #define LIBSWD_MEMAP_BASE_BASEADDR_BITNUM     12
@@ -448,6 +483,74 @@
 #define LIBSWD_RETRY_COUNT_DEFAULT 10
 /// Retry delay default value
 #define LIBSWD_RETRY_DELAY_DEFAULT 5
+/// Idle clock cycles inserted before ACK WAIT retry.
+#define LIBSWD_WAIT_IDLE_DEFAULT     8
+/// Initial ACK WAIT backoff delay [us], doubled on every retry.
+#define LIBSWD_WAIT_DELAY_DEFAULT    LIBSWD_RETRY_DELAY_DEFAULT
+/// Maximal ACK WAIT backoff delay [us].
+#define LIBSWD_WAIT_DELAYMAX_DEFAULT 10000
+/// ACK WAIT deadline [us], DAPABORT is issued after that time.
+#define LIBSWD_WAIT_TIMEOUT_DEFAULT  500000
+/// MEM-AP block transfer auto-resume attempts, zero disables auto-resume.
+#define LIBSWD_MEMAP_RESUME_DEFAULT  0
+/// Value match read retry count used by libswd_transfer().
+#define LIBSWD_MATCH_RETRY_DEFAULT   100
+/// Maximum number of libswd_transfer() entries used by libswd_memap_plan_run().
+#define LIBSWD_MEMAP_PLAN_XFERS      12
+/// Largest gap between scatter-gather regions read through instead of TAR rewrite [bytes].
+#define LIBSWD_MEMAP_SG_GAP          8
+/// Scatter-gather regions longer than this go to the block engine instead of batch [words].
+#define LIBSWD_MEMAP_SG_BULK         256
+/// Default streaming memory dump chunk size [bytes], two chunks are allocated.
+#define LIBSWD_MEMAP_DUMP_CHUNK      65536
+/// Memory read cache never holds the region (peripherals).
+#define LIBSWD_MEMCACHE_POLICY_NEVER   0
+/// Memory read cache holds the region while the core is halted (RAM).
+#define LIBSWD_MEMCACHE_POLICY_HALTED  1
+/// Memory read cache holds the region regardless of run state (ROM, flash).
+#define LIBSWD_MEMCACHE_POLICY_ALWAYS  2
+/// Addresses below this use LIBSWD_MEMCACHE_POLICY_HALTED, above LIBSWD_MEMCACHE_POLICY_NEVER, unless region says otherwise.
+#define LIBSWD_MEMCACHE_DEFAULT_LIMIT  0x40000000
+/// Writes to never cached addresses below this (peripherals) drop the whole cache.
+#define LIBSWD_MEMCACHE_PPB_ADDR       0xE0000000
+/// Default memory read cache page size [bytes].
+#define LIBSWD_MEMCACHE_PAGESIZE       256
+/// Default number of memory read cache pages.
+#define LIBSWD_MEMCACHE_PAGES          64
+/// Maximum number of memory read cache region policies.
+#define LIBSWD_MEMCACHE_REGIONS        16
+/// Statistics time class: command queue flush (bus and driver time).
+#define LIBSWD_STATS_CLASS_BUS         0
+/// Statistics time class: DAP batches, libswd_transfer() and libswd_ap_stream().
+#define LIBSWD_STATS_CLASS_DAP         1
+/// Statistics time class: MEM-AP memory transfers.
+#define LIBSWD_STATS_CLASS_MEMAP       2
+/// Number of statistics time classes.
+#define LIBSWD_STATS_CLASSES           3
+/// Default minimal interval between progress callback invocations [us].
+#define LIBSWD_STATS_PROGRESS_DEFAULT  100000
+/// Cached TAR value is not known (TAR was auto incremented).
+#define LIBSWD_MEMAP_TAR_UNKNOWN     (-1)
+/// Banked Data registers window size [bytes].
+#define LIBSWD_MEMAP_BD_WINDOW       16
+/// TAR auto increment wrap size guaranteed by ADIv5 [bytes].
+#define LIBSWD_MEMAP_TARWRAP_MIN     1024
+/// Largest TAR auto increment wrap size probed by libswd_memap_tarwrap() [bytes].
+#define LIBSWD_MEMAP_TARWRAP_MAX     65536
+/// Register poll deadline [us] used by libswd_memap_poll() callers.
+#define LIBSWD_MEMAP_POLL_TIMEOUT_DEFAULT 500000
+/// Pushed-compare writes per libswd_memap_poll() iteration.
+#define LIBSWD_MEMAP_POLL_BURST      16
+/// Target routine deadline [us] used by libswd_stub_run().
+#define LIBSWD_STUB_TIMEOUT_DEFAULT  5000000
+/// Minimal stack space left in the work area above the routine code [bytes].
+#define LIBSWD_STUB_STACK            64
+/// Smallest aligned bulk handed over to the on-target fill routine by libswd_memap_fill() [bytes].
+#define LIBSWD_STUB_FILL_MIN         4096
+/// Compressed chunk must be at least 1/LIBSWD_STUB_RLE_GAIN smaller than plain data, or it is read plainly.
+#define LIBSWD_STUB_RLE_GAIN         8
+/// Smallest work area staging buffer worth compressed reads [bytes].
+#define LIBSWD_STUB_RLE_MIN          256
 
 /** Payload for commands that will not change, transmitted MSBFirst */
 /// SW-DP Reset sequence.
@@ -458,6 +561,10 @@ static const char LIBSWD_CMD_JTAG2SWD[]  = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
 static const char LIBSWD_CMD_SWD2JTAG[]  = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x3c, 0xe7};
 /// Inserts idle clocks for proper data processing.
 static const char LIBSWD_CMD_IDLE[] = {0x00};
+/// Wakes SWDv2 DAP from Dormant to SWD (8 high, Selection Alert, 4 low, SWD Activation Code).
+static const char LIBSWD_CMD_DORMANT2SWD[] = {0xff, 0x92, 0xf3, 0x09, 0x62, 0x95, 0x2d, 0x85, 0x86, 0xe9, 0xaf, 0xdd, 0xe3, 0xa2, 0x0e, 0xbc, 0x19, 0xa0, 0x01};
+/// Switches SWDv2 DAP from SWD to Dormant.
+static const char LIBSWD_CMD_SWD2DORMANT[] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xbc, 0xe3};
 
 /** Status and Error Codes definitions */
 /// Error Codes definition, use this to have its name on debugger.
@@ -508,7 +615,10 @@ typedef enum {
  LIBSWD_ERROR_FILE        =-45, ///< File I/O related problem.
  LIBSWD_ERROR_UNSUPPORTED =-46, ///< Target not supported.
  LIBSWD_ERROR_MEMAPACCSIZE=-47, ///< Invalid MEM-AP access size.
- LIBSWD_ERROR_MEMAPALIGN  =-48  ///< Invalid MEM-AP allignment.
+ LIBSWD_ERROR_MEMAPALIGN  =-48, ///< Invalid MEM-AP allignment.
+ LIBSWD_ERROR_TIMEOUT     =-49, ///< Operation deadline exceeded.
+ LIBSWD_ERROR_MISMATCH    =-50, ///< Value match failed.
+ LIBSWD_ERROR_WORKAREA    =-51  ///< Target work area not set or too small.
 } libswd_error_code_t;
 
 /// Do we want autofix errors by default? Not at this point...
@@ -607,6 +717,7 @@ typedef struct libswd_cmd_t {
  libswd_cmdtype_t cmdtype; ///< Command type as defined by libswd_cmdtype_t.
  char done;       ///< Non-zero if operation already executed.
  struct libswd_cmd_t *errors;///<Pointer to the error/retry handling command/queue.
+ int result;      ///< Result slot (index+1) filled on transmit, 0 if none.
  struct libswd_cmd_t *prev; ///< Pointer to the previous command.
  struct libswd_cmd_t *next; ///< Pointer to the next command.
 } libswd_cmd_t;
@@ -618,6 +729,15 @@ typedef struct {
  int  maxcmdqlen;         ///< How long command queue can be.
  libswd_loglevel_t loglevel; ///< Holds Logging Level setting.
  char autofixerrors;      ///< Try to fix errors, return error code if not possible.
+ int  waitidle;           ///< Idle clock cycles inserted before ACK WAIT retry.
+ int  waitdelay;          ///< Initial ACK WAIT backoff delay [us].
+ int  waitdelaymax;       ///< Maximal ACK WAIT backoff delay [us].
+ int  waittimeout;        ///< ACK WAIT deadline [us] before DAPABORT.
+ int  memapresume;        ///< MEM-AP block transfer auto-resume attempts.
+ int  matchretry;         ///< Value match read retry count.
+ int  stubaddr;           ///< Target RAM work area address for on-target routines.
+ int  stubsize;           ///< Target RAM work area size [bytes], 0 when not set.
+ int  stubtimeout;        ///< On-target routine deadline [us].
 } libswd_context_config_t;
 
 /** Most actual Serial Wire Debug Port Registers */
@@ -633,6 +753,7 @@ typedef struct {
  int resend;      ///< Last known RESEND register value.
  int rdbuff;      ///< Last known RDBUFF register (payload data) value.
  int routesel;    ///< Last known ROUTESEL register value.
+ int targetsel;   ///< Last known TARGETSEL register value.
 } libswd_swdp_t;
 
 /** Most actual MEM-AP (Memory Access Port) register values (cache). */
@@ -649,8 +770,30 @@ typedef struct {
  int cfg;         ///< Last known CFG register value.
  int base;        ///< Last known BASE register value.
  int idr;         ///< Last known IDR register value.
+ int tarwrap;     ///< TAR auto increment wrap size [bytes], 0 if not probed.
+ char packed;     ///< Packed transfers support: 1 supported, -1 not supported, 0 unknown.
+ char bswap;      ///< Host and target byte order differ, memory image words are byte swapped.
 } libswd_memap_t;
 
+/** Access Port table entry, filled by libswd_ap_scan(). */
+typedef struct {
+ char present;    ///< Non-zero if AP IDR is implemented (non-zero).
+ char type;       ///< AP IDR TYPE field.
+ char apclass;    ///< AP IDR CLASS field.
+ int idr;         ///< AP IDR register value.
+ int cfg;         ///< AP CFG register value.
+ int base;        ///< AP BASE register value.
+ libswd_memap_t memap; ///< Cached MEM-AP registers of this AP.
+} libswd_ap_t;
+
+/** Access Port table, one entry for each APSEL value. */
+typedef struct {
+ char scanned;    ///< Non-zero if AP table was filled by libswd_ap_scan().
+ int count;       ///< Number of present APs.
+ int current;     ///< APSEL of the AP that log.memap belongs to.
+ libswd_ap_t ap[LIBSWD_AP_COUNT]; ///< AP entries indexed by APSEL.
+} libswd_aptable_t;
+
 /** Most actual SWD bus transaction/packet data.
  * This structure is updated by libswd_drv_transmit() function.
  * For clarity, it should not be updated by any other function.
@@ -765,6 +908,7 @@ typedef struct libswd_debug {
 #define LIBSWD_ARM_DEBUG_DCRSR_ADDR  0xE000EDF4
 #define LIBSWD_ARM_DEBUG_DCRDR_ADDR  0xE000EDF8
 #define LIBSWD_ARM_DEBUG_DEMCR_ADDR  0xE000EDFC
+#define LIBSWD_ARM_DEBUG_AIRCR_ADDR  0xE000ED0C
 
 #define LIBSWD_ARM_DEBUG_DHCSR_DBGKEY_BITNUM     16
 #define LIBSWD_ARM_DEBUG_DHCSR_DBGKEY_VAL        0xA05F /* Remember to write this key every time DHCSR is written. */
@@ -792,6 +936,287 @@ typedef struct libswd_debug {
 #define LIBSWD_ARM_DEBUG_DHCSR_CHALT             (1 << LIBSWD_ARM_DEBUG_DHCSR_CHALT_BITNUM)
 #define LIBSWD_ARM_DEBUG_DHCSR_CDEBUGEN          (1 << LIBSWD_ARM_DEBUG_DHCSR_CDEBUGEN_BITNUM)
 
+#define LIBSWD_ARM_DEBUG_DCRSR_REGWNR_BITNUM     16
+#define LIBSWD_ARM_DEBUG_DCRSR_REGSEL_BITNUM     0
+#define LIBSWD_ARM_DEBUG_DCRSR_REGWNR            (1 << LIBSWD_ARM_DEBUG_DCRSR_REGWNR_BITNUM)
+#define LIBSWD_ARM_DEBUG_DCRSR_REGSEL            (0x7F << LIBSWD_ARM_DEBUG_DCRSR_REGSEL_BITNUM)
+
+#define LIBSWD_ARM_DEBUG_DFSR_BKPT_BITNUM        1
+#define LIBSWD_ARM_DEBUG_DFSR_HALTED_BITNUM      0
+#define LIBSWD_ARM_DEBUG_DFSR_BKPT               (1 << LIBSWD_ARM_DEBUG_DFSR_BKPT_BITNUM)
+#define LIBSWD_ARM_DEBUG_DFSR_HALTED             (1 << LIBSWD_ARM_DEBUG_DFSR_HALTED_BITNUM)
+
+/// Core register numbers as selected with DCRSR REGSEL.
+#define LIBSWD_ARM_REG_R0     0
+#define LIBSWD_ARM_REG_R1     1
+#define LIBSWD_ARM_REG_R2     2
+#define LIBSWD_ARM_REG_R3     3
+#define LIBSWD_ARM_REG_R12    12
+#define LIBSWD_ARM_REG_SP     13
+#define LIBSWD_ARM_REG_LR     14
+#define LIBSWD_ARM_REG_PC     15 /* DebugReturnAddress. */
+#define LIBSWD_ARM_REG_XPSR   16
+/// Number of core registers saved around on-target routine run (R0..R12, SP, LR, PC, xPSR).
+#define LIBSWD_ARM_REG_COUNT  17
+/// xPSR Thumb state bit, must be set for Cortex-M to execute.
+#define LIBSWD_ARM_XPSR_T     (1 << 24)
+
+/** Position independent Thumb routine executed on target, see libswd_stub_run().
+ * Routine gets its arguments in R0..R3, returns the result in R0, uses the
+ * stack set up at the work area end and must stop the core with BKPT.
+ * Code is loaded at word aligned address, so PC relative literals work,
+ * but note that instructions are always little-endian on Cortex-M while
+ * literal data follows target data endianness.
+ */
+typedef struct {
+ const char *name;            ///< Routine name.
+ const unsigned char *code;   ///< Thumb machine code.
+ int size;                    ///< Code size [bytes].
+} libswd_stub_t;
+
+/** CRC-32 (IEEE 802.3), R0=addr, R1=count, R2=crc of previous data or 0,
+ * R3=reflected polynomial (LIBSWD_STUB_CRC32_POLY), returns crc in R0.
+ * Polynomial is passed in register rather than literal pool, so routine
+ * does not depend on target data endianness. Bitwise, ARMv6-M safe.
+ */
+static const unsigned char libswd_stub_code_crc32[] = {
+ 0xd2, 0x43, 0x00, 0x29, 0x0a, 0xd0, 0x04, 0x78, 0x01, 0x30, 0x62, 0x40,
+ 0x08, 0x25, 0x52, 0x08, 0x00, 0xd3, 0x5a, 0x40, 0x01, 0x3d, 0xfa, 0xd1,
+ 0x01, 0x39, 0xf4, 0xd1, 0xd0, 0x43, 0x00, 0xbe,
+};
+
+/** Blank check, R0=addr, R1=count, R2=byte value, returns number of leading
+ * bytes equal to value in R0 (count when whole region is blank).
+ */
+static const unsigned char libswd_stub_code_blank[] = {
+ 0x03, 0x00, 0x00, 0x29, 0x05, 0xd0, 0x04, 0x78, 0x94, 0x42, 0x02, 0xd1,
+ 0x01, 0x30, 0x01, 0x39, 0xf9, 0xd1, 0xc0, 0x1a, 0x00, 0xbe,
+};
+
+/** Word fill, R0=addr (word aligned), R1=count (multiple of 4), R2=word. */
+static const unsigned char libswd_stub_code_fill[] = {
+ 0x00, 0x29, 0x02, 0xd0, 0x04, 0xc0, 0x04, 0x39, 0xfc, 0xd1, 0x00, 0xbe,
+};
+
+/** PackBits style RLE compressor, R0=src, R1=count, R2=dst, R3=dst end,
+ * returns compressed size in R0 or -1 when output would pass dst end.
+ * Control byte 0..127 is followed by 1..128 literal bytes, control byte
+ * 128..255 is followed by one byte repeated 3..130 times.
+ */
+static const unsigned char libswd_stub_code_rle[] = {
+ 0x41, 0x18, 0x94, 0x46, 0x88, 0x42, 0x35, 0xd2, 0x05, 0x78, 0x01, 0x26,
+ 0x87, 0x19, 0x8f, 0x42, 0x05, 0xd2, 0x3f, 0x78, 0xaf, 0x42, 0x02, 0xd1,
+ 0x01, 0x36, 0x82, 0x2e, 0xf6, 0xd1, 0x03, 0x2e, 0x09, 0xd3, 0x97, 0x1c,
+ 0x9f, 0x42, 0x28, 0xd8, 0x7d, 0x27, 0xbf, 0x19, 0x17, 0x70, 0x55, 0x70,
+ 0x02, 0x32, 0x80, 0x19, 0xe6, 0xe7, 0x00, 0x26, 0x87, 0x19, 0x8f, 0x42,
+ 0x0c, 0xd2, 0xbd, 0x1c, 0x8d, 0x42, 0x06, 0xd2, 0x3d, 0x78, 0x7c, 0x78,
+ 0xac, 0x42, 0x02, 0xd1, 0xbc, 0x78, 0xac, 0x42, 0x02, 0xd0, 0x01, 0x36,
+ 0x80, 0x2e, 0xef, 0xd1, 0x97, 0x19, 0x01, 0x37, 0x9f, 0x42, 0x0c, 0xd8,
+ 0x77, 0x1e, 0x17, 0x70, 0x01, 0x32, 0x07, 0x78, 0x17, 0x70, 0x01, 0x30,
+ 0x01, 0x32, 0x01, 0x3e, 0xf9, 0xd1, 0xc7, 0xe7, 0x60, 0x46, 0x10, 0x1a,
+ 0x00, 0xbe, 0x00, 0x20, 0xc0, 0x43, 0x00, 0xbe,
+};
+
+/// Built-in on-target routines, indexed with LIBSWD_STUB_* numbers.
+static const libswd_stub_t libswd_stub_builtin[] = {
+ { .name="crc32", .code=libswd_stub_code_crc32, .size=sizeof(libswd_stub_code_crc32) },
+ { .name="blank", .code=libswd_stub_code_blank, .size=sizeof(libswd_stub_code_blank) },
+ { .name="fill",  .code=libswd_stub_code_fill,  .size=sizeof(libswd_stub_code_fill)  },
+ { .name="rle",   .code=libswd_stub_code_rle,   .size=sizeof(libswd_stub_code_rle)   },
+};
+
+#define LIBSWD_STUB_CRC32     0
+#define LIBSWD_STUB_BLANK     1
+#define LIBSWD_STUB_FILL      2
+#define LIBSWD_STUB_RLE       3
+
+/// CRC-32 (IEEE 802.3) polynomial in reflected form.
+#define LIBSWD_STUB_CRC32_POLY 0xEDB88320
+
+
+/** Overrun detection (CTRL/STAT ORUNDETECT) streaming state.
+ * While active, libswd_drv_transmit() does not truncate the queue on ACK!=OK,
+ * it only remembers the first rejected transaction, so long runs of AP
+ * accesses can be flushed at once and verified with a single CTRL/STAT read.
+ */
+typedef struct {
+ char active;     ///< Non-zero while ACK verification is deferred.
+ int count;       ///< Number of ACKs received in the current stream.
+ int failed;      ///< Index of the first transaction with ACK!=OK, -1 if none.
+ char ack;        ///< ACK value of the first failed transaction.
+ int done;        ///< Number of leading accesses acknowledged by the last run.
+} libswd_stream_t;
+
+/** Transfer statistics, collected per context (session).
+ * Counters are updated at the driver and queue level, so they reflect
+ * what really went over the wire. Read with libswd_stats_get().
+ */
+typedef struct {
+ unsigned long long bytes;        ///< Memory bytes transferred by MEM-AP engines.
+ unsigned long long transactions; ///< SWD packet requests sent.
+ unsigned long long bits;         ///< Clock cycles driven on the wire.
+ unsigned long long drvcalls;     ///< Calls to libswd_drv_{mosi,miso}_* functions.
+ unsigned long long roundtrips;   ///< Queue flushes, each is interface round trip.
+ unsigned long waits;             ///< ACK WAIT responses received.
+ unsigned long retries;           ///< Requests reissued after ACK WAIT.
+ unsigned long recovered;         ///< Transactions completed after ACK WAIT.
+ unsigned long aborts;            ///< DAPABORTs issued on ACK WAIT deadline.
+ unsigned long maxretries;        ///< Longest ACK WAIT retry sequence seen.
+ unsigned long long waittime;     ///< Cumulative time spent in ACK WAIT retry [us].
+ unsigned long faults;            ///< ACK FAULT responses received.
+ unsigned long parity;            ///< Read data parity errors.
+ unsigned long long time[LIBSWD_STATS_CLASSES]; ///< Cumulative time per API class [us].
+} libswd_stats_t;
+
+/** Statistics collection state, internal time accounting and progress callback. */
+typedef struct {
+ void (*progress)(void *libswdctx, void *priv, int done, int total); ///< Optional progress callback.
+ void *priv;                      ///< Progress callback private data.
+ int interval;                    ///< Minimal interval between progress calls [us].
+ unsigned long long last;         ///< Time of the last progress call [us].
+ int depth[LIBSWD_STATS_CLASSES]; ///< Nesting level of each API class.
+ unsigned long long start[LIBSWD_STATS_CLASSES]; ///< Time of the outermost call entry [us].
+} libswd_statsctl_t;
+
+/** MEM-AP block transfer result, updated by libswd_memap_*_int().
+ * On failure it tells how far the transfer got, so the caller can continue
+ * from the failing address instead of restarting whole transfer.
+ */
+typedef struct {
+ int count;       ///< Number of words requested.
+ int done;        ///< Number of words completed successfully.
+ int addr;        ///< Address of the failing (or next) word.
+ int error;       ///< Last error code, LIBSWD_OK if transfer completed.
+ int resumes;     ///< Number of auto-resumes performed during transfer.
+} libswd_memap_result_t;
+
+/** Unaligned MEM-AP access plan, see libswd_memap_plan(). */
+typedef struct {
+ int head;        ///< Number of bytes before the first word boundary.
+ int bulk;        ///< Number of whole words in the aligned section.
+ int tail;        ///< Number of bytes after the last whole word.
+ int size;        ///< Access size for head and tail [bytes], 1 or 2.
+} libswd_memap_plan_t;
+
+/** Scatter-gather MEM-AP region, see libswd_memap_read_sg(). */
+typedef struct {
+ int addr;        ///< Start address of the region.
+ int count;       ///< Number of bytes in the region.
+ char *data;      ///< Caller buffer holding the region data.
+} libswd_memap_sg_t;
+
+/** Streaming memory dump chunk handed over to the file writer, see libswd_memap_dump(). */
+typedef struct {
+ FILE *fp;        ///< Output file.
+ char *data;      ///< Chunk data.
+ int count;       ///< Number of bytes in the chunk.
+ int res;         ///< Write result, LIBSWD_OK or LIBSWD_ERROR_FILE.
+} libswd_memap_dump_t;
+
+/** MEM-AP read cache region policy, see libswd_memcache_region(). */
+typedef struct {
+ int addr;        ///< Start address of the region.
+ int size;        ///< Region size [bytes].
+ char policy;     ///< One of LIBSWD_MEMCACHE_POLICY_* values.
+} libswd_memcache_region_t;
+
+/** MEM-AP read cache page. */
+typedef struct {
+ char valid;              ///< Page holds target memory content.
+ int ap;                  ///< Access Port the page was read with.
+ int addr;                ///< Page start address.
+ unsigned long used;      ///< Last use stamp for page replacement.
+ unsigned char *data;     ///< Page content.
+} libswd_memcache_page_t;
+
+/** MEM-AP read cache, see libswd_memcache_enable(). */
+typedef struct {
+ int pagesize;                 ///< Page size [bytes], 0 when cache is disabled.
+ int pagecount;                ///< Number of pages.
+ libswd_memcache_page_t *page; ///< Pages table.
+ unsigned char *data;          ///< Memory for all pages content.
+ int regioncount;              ///< Number of region policies.
+ libswd_memcache_region_t region[LIBSWD_MEMCACHE_REGIONS]; ///< Region policies, last match wins.
+ unsigned long stamp;          ///< Page use counter.
+ unsigned long hits;           ///< Number of pages served from cache.
+ unsigned long misses;         ///< Number of pages read from target.
+ unsigned long invalidations;  ///< Number of pages invalidated.
+} libswd_memcache_t;
+
+/** Operation scheduled for a multi-drop target, see libswd_dap_target_schedule(). */
+typedef struct libswd_target_job {
+ int (*fn)(void *libswdctx, void *arg); ///< Operation to run on selected target.
+ void *arg;                    ///< Operation argument.
+ struct libswd_target_job *next; ///< Next operation for the same target.
+} libswd_target_job_t;
+
+/** SWDv2 multi-drop target sub-context.
+ * Target state is swapped in and out of the main context log on target
+ * switch, so each target keeps its own DP/AP state over one SWD link.
+ */
+typedef struct {
+ int targetsel;             ///< TARGETSEL value (TINSTANCE, TPARTNO, TDESIGNER).
+ int idcode;                ///< IDCODE read after target was selected.
+ libswd_swdp_t dp;          ///< Saved SW-DP state.
+ libswd_memap_t memap;      ///< Saved MEM-AP state.
+ libswd_debug_t debug;      ///< Saved Debug state.
+ libswd_aptable_t aptable;  ///< Saved Access Port table.
+ libswd_target_job_t *jobs; ///< Scheduled operations (batch) for this target.
+} libswd_target_t;
+
+/** SWDv2 multi-drop bus targets. */
+typedef struct {
+ int count;                 ///< Number of targets on the bus.
+ int current;               ///< Index of the selected target, -1 if none.
+ libswd_target_t *target;   ///< Array of target sub-contexts.
+} libswd_multidrop_t;
+
+/// Magic value of the valid session descriptor.
+#define LIBSWD_SESSION_MAGIC 0x4C535744
+
+/** Session descriptor used for fast reconnect, see libswd_dap_reconnect().
+ * It contains plain values only, so it can be stored by the application
+ * (ie. into a file) and used by another process to reconnect.
+ */
+typedef struct {
+ int magic;             ///< LIBSWD_SESSION_MAGIC when descriptor is valid.
+ int idcode;            ///< Target's IDCODE.
+ int ctrlstat;          ///< DP CTRL/STAT value.
+ int select;            ///< DP SELECT value.
+ int ap;                ///< APSEL of the MEM-AP in use.
+ libswd_memap_t memap;  ///< MEM-AP registers cache.
+} libswd_session_t;
+
+/** Result slot of the enqueued read, see libswd_dp_read_result().
+ * Slot is filled in by the driver when bound commands are transmitted.
+ */
+typedef struct {
+ char ack;              ///< ACK of the read request, 0 until transmitted.
+ char done;             ///< Non-zero when data phase was transmitted.
+ char parity;           ///< Parity bit received with data.
+ int data;              ///< Data read from target.
+} libswd_result_t;
+
+/** Result slots of the enqueued reads, valid until libswd_result_reset(). */
+typedef struct {
+ int count;             ///< Number of slots in use.
+ int size;              ///< Number of slots allocated.
+ libswd_result_t *slot; ///< Slots array.
+ libswd_cmd_t *rdbuff;  ///< Trailing RDBUFF read request of the last AP read.
+ libswd_cmd_t *rdbuffparity; ///< Parity of the trailing RDBUFF read.
+} libswd_results_t;
+
+/** Single entry of the libswd_transfer() list. */
+typedef struct {
+ char APnDP;            ///< 1 for AP access, 0 for DP access.
+ char RnW;              ///< 1 for read, 0 for write.
+ char addr;             ///< Register address, AP BANK on bits [4..7].
+ int value;             ///< Value to write or value read.
+ int *data;             ///< Optional value location used instead of value.
+ int matchmask;         ///< Read until (value&matchmask)==matchvalue, 0 disables.
+ int matchvalue;        ///< Expected value for the match read.
+ int handle;            ///< Result handle, used internally.
+} libswd_xfer_t;
 
 /** SWD Context Structure definition. It stores all the information about
  * the library, drivers and interface configuration, target status along
@@ -818,6 +1243,14 @@ typedef struct {
   libswd_transaction_t read;     ///< Data queued for read.
   libswd_transaction_t write;    ///< Data queued for write.
  } qlog;
+ libswd_stream_t stream;         ///< Overrun detection streaming state.
+ libswd_stats_t stats;           ///< Transfer statistics.
+ libswd_statsctl_t statsctl;     ///< Statistics collection state.
+ libswd_memap_result_t memapresult; ///< Last MEM-AP block transfer result.
+ libswd_aptable_t aptable;       ///< Discovered Access Ports.
+ libswd_multidrop_t multidrop;   ///< SWDv2 multi-drop targets.
+ libswd_results_t results;       ///< Result slots of the enqueued reads.
+ libswd_memcache_t memcache;     ///< MEM-AP read cache.
 } libswd_ctx_t;
 
 
@@ -831,6 +1264,13 @@ char *libswd_bin8_string(char *data);
 char *libswd_bin32_string(int *data);
 int libswd_bin8_bitswap(unsigned char *buffer, unsigned int bitcount);
 int libswd_bin32_bitswap(unsigned int *buffer, unsigned int bitcount);
+int libswd_bin_compare(const char *a, const char *b, int count);
+int libswd_bin_bswap32(char *data, int count);
+int libswd_bin_bigendian(void);
+#ifdef __PCLMUL__
+unsigned int libswd_bin_crc32_pclmul(unsigned int crc, const unsigned char *data, int count);
+#endif
+unsigned int libswd_bin_crc32(unsigned int crc, const char *data, int count);
 
 int libswd_cmdq_init(libswd_cmd_t *cmdq);
 libswd_cmd_t* libswd_cmdq_find_head(libswd_cmd_t *cmdq);
@@ -864,6 +1304,8 @@ int libswd_cmd_enqueue_mosi_dap_reset(libswd_ctx_t *libswdctx);
 int libswd_cmd_enqueue_mosi_idle(libswd_ctx_t *libswdctx);
 int libswd_cmd_enqueue_mosi_jtag2swd(libswd_ctx_t *libswdctx);
 int libswd_cmd_enqueue_mosi_swd2jtag(libswd_ctx_t *libswdctx);
+int libswd_cmd_enqueue_mosi_dormant2swd(libswd_ctx_t *libswdctx);
+int libswd_cmd_enqueue_mosi_swd2dormant(libswd_ctx_t *libswdctx);
 
 char *libswd_cmd_string_cmdtype(libswd_cmd_t *cmd);
 
@@ -892,6 +1334,14 @@ int libswd_log_internal(libswd_ctx_t *libswdctx, libswd_loglevel_t loglevel, cha
 int libswd_log_internal_va(libswd_ctx_t *libswdctx, libswd_loglevel_t loglevel, char *msg, va_list ap);
 int libswd_log_level_set(libswd_ctx_t *libswdctx, libswd_loglevel_t loglevel);
 int libswd_log_level_get(libswd_ctx_t *libswdctx);
+unsigned long long libswd_stats_time(void);
+int libswd_stats_enter(libswd_ctx_t *libswdctx, int apiclass);
+int libswd_stats_leave(libswd_ctx_t *libswdctx, int apiclass);
+int libswd_stats_get(libswd_ctx_t *libswdctx, libswd_stats_t *stats);
+int libswd_stats_reset(libswd_ctx_t *libswdctx);
+int libswd_stats_progress_set(libswd_ctx_t *libswdctx, void (*progress)(void *libswdctx, void *priv, int done, int total), void *priv, int interval);
+int libswd_stats_progress(libswd_ctx_t *libswdctx, int done, int total);
+int libswd_stats_print(libswd_ctx_t *libswdctx);
 extern int libswd_log_level_inherit(libswd_ctx_t *libswdctx, int loglevel);
 const char *libswd_log_level_string(libswd_loglevel_t loglevel);
 const char *libswd_operation_string(libswd_operation_t operation);
@@ -912,6 +1362,21 @@ int libswd_dp_read(libswd_ctx_t *libswdctx, libswd_operation_t operation, char a
 int libswd_dp_write(libswd_ctx_t *libswdctx, libswd_operation_t operation, char addr, int *data);
 int libswd_ap_read(libswd_ctx_t *libswdctx, libswd_operation_t operation, char addr, int **data);
 int libswd_ap_write(libswd_ctx_t *libswdctx, libswd_operation_t operation, char addr, int *data);
+int libswd_ap_bank_select(libswd_ctx_t *libswdctx, libswd_operation_t operation, int addr);
+int libswd_ap_select(libswd_ctx_t *libswdctx, libswd_operation_t operation, int ap);
+int libswd_ap_scan(libswd_ctx_t *libswdctx, int *count);
+int libswd_ap_stream_stride(libswd_ctx_t *libswdctx, char RnW, char addr, int *data, int count, int stride);
+int libswd_ap_stream(libswd_ctx_t *libswdctx, char RnW, char addr, int *data, int count);
+int libswd_ap_read_stream(libswd_ctx_t *libswdctx, char addr, int *data, int count);
+int libswd_ap_write_stream(libswd_ctx_t *libswdctx, char addr, int *data, int count);
+int libswd_ap_fill_stream(libswd_ctx_t *libswdctx, char addr, int *data, int count);
+int libswd_result_alloc(libswd_ctx_t *libswdctx);
+int libswd_dp_read_result(libswd_ctx_t *libswdctx, char addr);
+int libswd_ap_read_result(libswd_ctx_t *libswdctx, char addr);
+int libswd_result_update(libswd_ctx_t *libswdctx, libswd_cmd_t *cmd);
+int libswd_result_get(libswd_ctx_t *libswdctx, int handle, int *data);
+int libswd_result_reset(libswd_ctx_t *libswdctx);
+int libswd_transfer(libswd_ctx_t *libswdctx, libswd_xfer_t *list, int n, int *failed);
 
 
 int libswd_dap_init(libswd_ctx_t *libswdctx, libswd_operation_t operation, int **idcode);
@@ -919,28 +1384,82 @@ int libswd_dap_setup(libswd_ctx_t *libswdctx, libswd_operation_t operation, int
 int libswd_dap_reset(libswd_ctx_t *libswdctx, libswd_operation_t operation);
 int libswd_dap_select(libswd_ctx_t *libswdctx, libswd_operation_t operation);
 int libswd_dap_detect(libswd_ctx_t *libswdctx, libswd_operation_t operation, int **idcode);
+int libswd_dap_trnmode(libswd_ctx_t *libswdctx, libswd_operation_t operation, int trnmode, int masklane);
+int libswd_dap_session_save(libswd_ctx_t *libswdctx, libswd_session_t *session);
+int libswd_dap_reconnect(libswd_ctx_t *libswdctx, libswd_session_t *session, int **idcode);
+int libswd_dap_dormant_wakeup(libswd_ctx_t *libswdctx, libswd_operation_t operation);
+int libswd_dp_targetsel(libswd_ctx_t *libswdctx, libswd_operation_t operation, int *targetsel);
+int libswd_dap_target_add(libswd_ctx_t *libswdctx, int targetsel);
+int libswd_dap_target_select(libswd_ctx_t *libswdctx, int target);
+int libswd_dap_target_schedule(libswd_ctx_t *libswdctx, int target, int (*fn)(void *libswdctx, void *arg), void *arg);
+int libswd_dap_target_run(libswd_ctx_t *libswdctx);
 int libswd_dap_errors_handle(libswd_ctx_t *libswdctx, libswd_operation_t operation, int *abort, int *ctrlstat);
+int libswd_dap_retry_wait(libswd_ctx_t *libswdctx, char request, int *wdata, int **rdata, char **rparity);
 
 int libswd_memap_init(libswd_ctx_t *libswdctx, libswd_operation_t operation);
 int libswd_memap_setup(libswd_ctx_t *libswdctx, libswd_operation_t operation, int csw, int tar);
+int libswd_memap_resume(libswd_ctx_t *libswdctx, int error, int addr);
+int libswd_memap_select(libswd_ctx_t *libswdctx, libswd_operation_t operation, int ap);
+int libswd_memap_tarwrap(libswd_ctx_t *libswdctx, int addr, int size);
+int libswd_memap_bd(libswd_ctx_t *libswdctx, char RnW, int addr, int *data);
+int libswd_memap_read_block(libswd_ctx_t *libswdctx, int addr, int count, int *data);
 int libswd_memap_read_char(libswd_ctx_t *libswdctx, libswd_operation_t operation, int addr, int count, char *data);
 int libswd_memap_read_char_csw(libswd_ctx_t *libswdctx, libswd_operation_t operation, int addr, int count, char *data, int csw);
 int libswd_memap_read_char_32(libswd_ctx_t *libswdctx, libswd_operation_t operation, int addr, int count, char *data);
 int libswd_memap_read_int(libswd_ctx_t *libswdctx, libswd_operation_t operation, int addr, int count, int *data);
 int libswd_memap_read_int_csw(libswd_ctx_t *libswdctx, libswd_operation_t operation, int addr, int count, int *data, int csw);
 int libswd_memap_read_int_32(libswd_ctx_t *libswdctx, libswd_operation_t operation, int addr, int count, int *data);
+int libswd_memap_write_block_stride(libswd_ctx_t *libswdctx, int addr, int count, int *data, int stride);
+int libswd_memap_write_block(libswd_ctx_t *libswdctx, int addr, int count, int *data);
 int libswd_memap_write_char(libswd_ctx_t *libswdctx, libswd_operation_t operation, int addr, int count, char *data);
 int libswd_memap_write_char_csw(libswd_ctx_t *libswdctx, libswd_operation_t operation, int addr, int count, char *data, int csw);
 int libswd_memap_write_char_32(libswd_ctx_t *libswdctx, libswd_operation_t operation, int addr, int count, char *data);
 int libswd_memap_write_int(libswd_ctx_t *libswdctx, libswd_operation_t operation, int addr, int count, int *data);
 int libswd_memap_write_int_csw(libswd_ctx_t *libswdctx, libswd_operation_t operation, int addr, int count, int *data, int csw);
 int libswd_memap_write_int_32(libswd_ctx_t *libswdctx, libswd_operation_t operation, int addr, int count, int *data);
+int libswd_memap_image2drw(libswd_ctx_t *libswdctx, const char *image, int count, int *drw);
+int libswd_memap_drw2image(libswd_ctx_t *libswdctx, int *drw, int count, char *image);
+int libswd_memap_plan(int addr, int count, libswd_memap_plan_t *plan);
+int libswd_memap_plan_run(libswd_ctx_t *libswdctx, libswd_memap_plan_t *plan, int addr, char RnW, char *data, int csw);
+int libswd_memap_read_any(libswd_ctx_t *libswdctx, int addr, int count, char *data);
+int libswd_memap_write_any(libswd_ctx_t *libswdctx, int addr, int count, char *data);
+int libswd_memap_sg_compare(const void *a, const void *b);
+int libswd_memap_sg_enqueue(libswd_ctx_t *libswdctx, libswd_xfer_t *list, int *tar, char RnW, int addr, int count, int *data);
+int libswd_memap_read_sg(libswd_ctx_t *libswdctx, libswd_memap_sg_t *list, int n);
+int libswd_memap_write_sg(libswd_ctx_t *libswdctx, libswd_memap_sg_t *list, int n);
+void *libswd_memap_dump_write(void *chunk);
+int libswd_memap_dump(libswd_ctx_t *libswdctx, int addr, int count, FILE *fp, int chunk);
+int libswd_memap_fill(libswd_ctx_t *libswdctx, int addr, int count, int pattern, int width);
+int libswd_memap_verify_int(libswd_ctx_t *libswdctx, libswd_operation_t operation, int addr, int count, int *data);
+int libswd_memap_verify_int_32(libswd_ctx_t *libswdctx, libswd_operation_t operation, int addr, int count, int *data);
+int libswd_memap_poll(libswd_ctx_t *libswdctx, int addr, int mask, int value, int timeout, int delay, int *data);
+int libswd_memcache_enable(libswd_ctx_t *libswdctx, int pages, int pagesize);
+int libswd_memcache_disable(libswd_ctx_t *libswdctx);
+int libswd_memcache_region(libswd_ctx_t *libswdctx, int addr, int size, char policy);
+int libswd_memcache_region_policy(libswd_ctx_t *libswdctx, int addr);
+int libswd_memcache_policy(libswd_ctx_t *libswdctx, int addr);
+int libswd_memcache_flush(libswd_ctx_t *libswdctx);
+int libswd_memcache_invalidate(libswd_ctx_t *libswdctx, int addr, int count);
+int libswd_memcache_fill(libswd_ctx_t *libswdctx, libswd_memcache_page_t *page, int addr);
+int libswd_memcache_read(libswd_ctx_t *libswdctx, int addr, int count, char *data);
 
 int libswd_debug_detect(libswd_ctx_t *libswdctx, libswd_operation_t operation);
 int libswd_debug_init(libswd_ctx_t *libswdctx, libswd_operation_t operation);
 int libswd_debug_halt(libswd_ctx_t *libswdctx, libswd_operation_t operation);
 int libswd_debug_run(libswd_ctx_t *libswdctx, libswd_operation_t operation);
 int libswd_debug_is_halted(libswd_ctx_t *libswdctx, libswd_operation_t operation);
+int libswd_debug_reg_wait(libswd_ctx_t *libswdctx);
+int libswd_debug_reg_read(libswd_ctx_t *libswdctx, int reg, int *value);
+int libswd_debug_reg_write(libswd_ctx_t *libswdctx, int reg, int value);
+
+int libswd_stub_workarea(libswd_ctx_t *libswdctx, int addr, int size);
+int libswd_stub_run(libswd_ctx_t *libswdctx, const libswd_stub_t *stub, int *args, int nargs, int *result);
+int libswd_stub_crc32(libswd_ctx_t *libswdctx, int addr, int count, unsigned int *crc);
+int libswd_stub_blank(libswd_ctx_t *libswdctx, int addr, int count, char value, int *offset);
+int libswd_stub_verify(libswd_ctx_t *libswdctx, int addr, int count, const char *data);
+int libswd_stub_fill(libswd_ctx_t *libswdctx, int addr, int count, int word);
+int libswd_stub_rle_decode(const unsigned char *in, int incount, char *out, int outcount);
+int libswd_stub_read_rle(libswd_ctx_t *libswdctx, int addr, int count, char *data);
 
 int libswd_cli(libswd_ctx_t *libswdctx, char *command);
 
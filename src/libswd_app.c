@@ -272,8 +272,8 @@ int libswdapp_handle_command_flash_usage(void){
 int libswdapp_handle_command_flash(libswdapp_context_t *libswdappctx, char *command)
 {
  if (!libswdappctx) return LIBSWD_ERROR_NULLCONTEXT;
- int i, j, retval, *idcode, flashdrvidx=0, dbgdhcsr, data, *datap, count, addr, addrstart;
- char buf[4], *cmd, *filename;
+ int i, j, retval, *idcode, flashdrvidx=0, dbgdhcsr, data, *datap, *words, count, addr, addrstart;
+ char buf[4], *cmd, *filename, *readback;
  libswd_ctx_t *libswdctx=(libswd_ctx_t*)libswdappctx->libswdctx;
  libswdapp_flash_stm32f1_memmap_t flash_memmap;
 
@@ -328,22 +328,7 @@ int libswdapp_handle_command_flash(libswdapp_context_t *libswdappctx, char *comm
     goto libswdapp_handle_command_flash_error;
    }
   }
-  // Take care of proper memory (re)allocation.
-  if (libswdctx->membuf.data) free(libswdctx->membuf.data);
-  libswdctx->membuf.data=(unsigned char*)malloc(count*sizeof(char));
-  if (!libswdctx->membuf.data)
-  {
-   libswdctx->membuf.size=0;
-   libswd_log(libswdctx, LIBSWD_ERROR_OUTOFMEM,
-              "FLASH ERROR: Cannot (re)allocate memory buffer!\n");
-   return LIBSWD_ERROR_OUTOFMEM;
-  } else memset((void*)libswdctx->membuf.data, 0xFF, count);
-  libswdctx->membuf.size=count*sizeof(char);
-  retval=libswd_memap_read_char_32(libswdctx, LIBSWD_OPERATION_EXECUTE,
-                           addrstart, count,
-                           (char *)libswdctx->membuf.data);
-  if (retval<0) goto libswdapp_handle_command_flash_error;
-  // Store result to a file if requested.
+  // Stream result to a file if requested, whole flash is not buffered.
   if (filename)
   {
    FILE *fp;
@@ -351,28 +336,41 @@ int libswdapp_handle_command_flash(libswdapp_context_t *libswdappctx, char *comm
    if (!fp)
    {
     libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR,
-               "FLASH ERROR: Cannot open '%s' data file!\n",
+               "FLASH ERROR: Cannot open '%s' data file (%s)!\n",
                filename, strerror(errno) );
     retval=LIBSWD_ERROR_FILE;
     goto libswdapp_handle_command_flash_error;
    }
-   retval=fwrite(libswdctx->membuf.data, sizeof(char), count, fp);
-   if (!retval)
-   {
-    libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR,
-               "FLASH ERROR: Cannot write to data file '%s' (%s)!\n",
-               filename, strerror(errno) );
-    goto libswdapp_handle_command_flash_error;
-   }
+   retval=libswd_memap_dump(libswdctx, addrstart, count, fp, 0);
    i=fclose(fp);
+   if (retval<0) goto libswdapp_handle_command_flash_error;
    if (i)
    {
     libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR,
                "FLASH ERROR: Cannot close data file '%s' (%s)!\n",
                filename, strerror(errno) );
+    retval=LIBSWD_ERROR_FILE;
     goto libswdapp_handle_command_flash_error;
    }
+   libswd_log(libswdctx, LIBSWD_LOGLEVEL_NORMAL,
+              "FLASH READ OK! Stored %d bytes to '%s'.\n", count, filename);
+   return LIBSWD_OK;
   }
+  // Take care of proper memory (re)allocation.
+  if (libswdctx->membuf.data) free(libswdctx->membuf.data);
+  libswdctx->membuf.data=(unsigned char*)malloc(count*sizeof(char));
+  if (!libswdctx->membuf.data)
+  {
+   libswdctx->membuf.size=0;
+   libswd_log(libswdctx, LIBSWD_ERROR_OUTOFMEM,
+              "FLASH ERROR: Cannot (re)allocate memory buffer!\n");
+   return LIBSWD_ERROR_OUTOFMEM;
+  } else memset((void*)libswdctx->membuf.data, 0xFF, count);
+  libswdctx->membuf.size=count*sizeof(char);
+  retval=libswd_memap_read_char_32(libswdctx, LIBSWD_OPERATION_EXECUTE,
+                           addrstart, count,
+                           (char *)libswdctx->membuf.data);
+  if (retval<0) goto libswdapp_handle_command_flash_error;
   // Print out the result.
   for (i=0; i<libswdctx->membuf.size; i=i+16)
   {
@@ -408,17 +406,8 @@ int libswdapp_handle_command_flash(libswdapp_context_t *libswdappctx, char *comm
   if (retval<0) goto libswdapp_handle_command_flash_error;
   // Perform Mass-Erase operation.
   //Wait for BSY flag clearance.
-  for (i=LIBSWD_RETRY_COUNT_DEFAULT;i;i--)
-  {
-   retval=libswd_memap_read_int_32(libswdctx, LIBSWD_OPERATION_EXECUTE, flash_memmap.FLASH_SR_ADDR, 1, &data);
-   if (!(data&LIBSWDAPP_FLASH_STM32F1_FLASH_SR_BSY)) break;
-   usleep(100);
-  }
-  if (!i)
-  {
-   retval=LIBSWD_ERROR_MAXRETRY;
-   goto libswdapp_handle_command_flash_error;
-  }
+  retval=libswd_memap_poll(libswdctx, flash_memmap.FLASH_SR_ADDR, LIBSWDAPP_FLASH_STM32F1_FLASH_SR_BSY, 0, LIBSWD_MEMAP_POLL_TIMEOUT_DEFAULT, 100, &data);
+  if (retval<0) goto libswdapp_handle_command_flash_error;
   //Set MER bit in FLASH_CR
   retval=libswd_memap_read_int_32(libswdctx, LIBSWD_OPERATION_EXECUTE, flash_memmap.FLASH_CR_ADDR, 1, &data);
   if (retval<0) goto libswdapp_handle_command_flash_error;
@@ -429,17 +418,8 @@ int libswdapp_handle_command_flash(libswdapp_context_t *libswdappctx, char *comm
   retval=libswd_memap_write_int_32(libswdctx, LIBSWD_OPERATION_EXECUTE, flash_memmap.FLASH_CR_ADDR, 1, &data);
   if (retval<0) goto libswdapp_handle_command_flash_error;
   //Wait for BSY flag clearance.
-  for (i=LIBSWD_RETRY_COUNT_DEFAULT;i;i--)
-  {
-   retval=libswd_memap_read_int_32(libswdctx, LIBSWD_OPERATION_EXECUTE, flash_memmap.FLASH_SR_ADDR, 1, &data);
-   if (!(data&LIBSWDAPP_FLASH_STM32F1_FLASH_SR_BSY)) break;
-   usleep(100);
-  }
-  if (!i)
-  {
-   retval=LIBSWD_ERROR_MAXRETRY;
-   goto libswdapp_handle_command_flash_error;
-  }
+  retval=libswd_memap_poll(libswdctx, flash_memmap.FLASH_SR_ADDR, LIBSWDAPP_FLASH_STM32F1_FLASH_SR_BSY, 0, LIBSWD_MEMAP_POLL_TIMEOUT_DEFAULT, 100, &data);
+  if (retval<0) goto libswdapp_handle_command_flash_error;
   libswd_log(libswdctx, LIBSWD_LOGLEVEL_NORMAL, "FLASH MASS-ERASE OK!\n");
  }
 
@@ -529,17 +509,8 @@ libswdapp_handle_command_flash_file_load_ok:
    // Perform Mass-Erase operation.
    libswd_log(libswdctx, LIBSWD_LOGLEVEL_NORMAL, "FLASH: Performing Flash Mass-Erase...\n");
    //Wait for BSY flag clearance.
-   for (i=LIBSWD_RETRY_COUNT_DEFAULT;i;i--)
-   {
-    retval=libswd_memap_read_int_32(libswdctx, LIBSWD_OPERATION_EXECUTE, flash_memmap.FLASH_SR_ADDR, 1, &data);
-    if (!(data&LIBSWDAPP_FLASH_STM32F1_FLASH_SR_BSY)) break;
-    usleep(LIBSWD_RETRY_DELAY_DEFAULT);
-   }
-   if (!i)
-   {
-    retval=LIBSWD_ERROR_MAXRETRY;
-    goto libswdapp_handle_command_flash_error;
-   }
+   retval=libswd_memap_poll(libswdctx, flash_memmap.FLASH_SR_ADDR, LIBSWDAPP_FLASH_STM32F1_FLASH_SR_BSY, 0, LIBSWD_MEMAP_POLL_TIMEOUT_DEFAULT, 100, &data);
+   if (retval<0) goto libswdapp_handle_command_flash_error;
    //Set MER bit in FLASH_CR
    retval=libswd_memap_read_int_32(libswdctx, LIBSWD_OPERATION_EXECUTE, flash_memmap.FLASH_CR_ADDR, 1, &data);
    if (retval<0) goto libswdapp_handle_command_flash_error;
@@ -550,17 +521,8 @@ libswdapp_handle_command_flash_file_load_ok:
    retval=libswd_memap_write_int_32(libswdctx, LIBSWD_OPERATION_EXECUTE, flash_memmap.FLASH_CR_ADDR, 1, &data);
    if (retval<0) goto libswdapp_handle_command_flash_error;
    //Wait for BSY flag clearance.
-   for (i=LIBSWD_RETRY_COUNT_DEFAULT;i;i--)
-   {
-    retval=libswd_memap_read_int_32(libswdctx, LIBSWD_OPERATION_EXECUTE, flash_memmap.FLASH_SR_ADDR, 1, &data);
-    if (!(data&LIBSWDAPP_FLASH_STM32F1_FLASH_SR_BSY)) break;
-    usleep(100);
-   }
-   if (!i)
-   {
-    retval=LIBSWD_ERROR_MAXRETRY;
-    goto libswdapp_handle_command_flash_error;
-   }
+   retval=libswd_memap_poll(libswdctx, flash_memmap.FLASH_SR_ADDR, LIBSWDAPP_FLASH_STM32F1_FLASH_SR_BSY, 0, LIBSWD_MEMAP_POLL_TIMEOUT_DEFAULT, 100, &data);
+   if (retval<0) goto libswdapp_handle_command_flash_error;
    // Perform Flash write.
    libswd_log(libswdctx, LIBSWD_LOGLEVEL_NORMAL, "FLASH: Performing Flash Write...\n");
    retval=libswd_memap_read_int_32(libswdctx, LIBSWD_OPERATION_EXECUTE, flash_memmap.FLASH_CR_ADDR, 1, &data);
@@ -589,7 +551,53 @@ libswdapp_handle_command_flash_file_load_ok:
     if (j<16) for (;j<16;j++)
      libswd_log(libswdctx, LIBSWD_LOGLEVEL_NORMAL, ".");
    }
-   libswd_log(libswdctx, LIBSWD_LOGLEVEL_NORMAL, "\nFLASH: WRITE OK!\n");
+   // Verify written data with on-target CRC-32 when work area is set,
+   // otherwise with pushed-verify, so image does not cross the wire again.
+   libswd_log(libswdctx, LIBSWD_LOGLEVEL_NORMAL, "\nFLASH: Verifying...\n");
+   if (libswdctx->config.stubsize)
+   {
+    retval=libswd_stub_verify(libswdctx, addr, count, (char *)libswdctx->membuf.data);
+   }
+   else
+   {
+    // Whole words are pushed, trailing bytes are read back.
+    words=(int*)malloc((count/4+1)*sizeof(int));
+    if (!words)
+    {
+     retval=LIBSWD_ERROR_OUTOFMEM;
+     goto libswdapp_handle_command_flash_error;
+    }
+    retval=libswd_memap_image2drw(libswdctx, (char *)libswdctx->membuf.data, count/4, words);
+    if (retval>=0 && count/4)
+     retval=libswd_memap_verify_int_32(libswdctx, LIBSWD_OPERATION_EXECUTE, addr, count/4, words);
+    if (retval>=0 && (count&3))
+    {
+     retval=libswd_memap_read_any(libswdctx, addr+(count&~3), count&3, (char*)words);
+     if (retval>=0 && memcmp(words, libswdctx->membuf.data+(count&~3), count&3))
+      retval=LIBSWD_ERROR_MISMATCH;
+    }
+    free(words);
+   }
+   if (retval==LIBSWD_ERROR_MISMATCH)
+   {
+    // Read back the image only to locate the mismatch.
+    readback=(char*)malloc(count);
+    if (!readback)
+    {
+     retval=LIBSWD_ERROR_OUTOFMEM;
+     goto libswdapp_handle_command_flash_error;
+    }
+    retval=libswd_memap_read_char_32(libswdctx, LIBSWD_OPERATION_EXECUTE, addr, count, readback);
+    if (retval>=0) i=libswd_bin_compare(readback, (char *)libswdctx->membuf.data, count);
+    free(readback);
+    if (retval<0) goto libswdapp_handle_command_flash_error;
+    libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR,
+               "FLASH ERROR: Verify failed at 0x%08X!\n", addr+i);
+    retval=LIBSWD_ERROR_MISMATCH;
+    goto libswdapp_handle_command_flash_error;
+   }
+   if (retval<0) goto libswdapp_handle_command_flash_error;
+   libswd_log(libswdctx, LIBSWD_LOGLEVEL_NORMAL, "FLASH: WRITE OK!\n");
   }
 
  return LIBSWD_OK;
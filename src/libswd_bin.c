@@ -35,6 +35,18 @@
 /** \file libswd_bin.c */
 
 #include <libswd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#ifdef __PCLMUL__
+#include <wmmintrin.h>
+#endif
 
 /*******************************************************************************
  * \defgroup libswd_bin Binary operations helper functions.
@@ -167,4 +179,217 @@ int libswd_bin32_bitswap(unsigned int *buffer, unsigned int bitcount){
  return bit;
 }
 
+
+/**
+ * Find first difference of two memory images, ie. data written and read back.
+ * Images are compared in 64-byte blocks with AVX2 or SSE2 when the compiler
+ * targets them, otherwise 8 bytes at a time, difference is then located
+ * byte by byte within the block.
+ * \param *a first image pointer.
+ * \param *b second image pointer.
+ * \param count number of bytes to compare.
+ * \return offset of the first differing byte, count when images are equal, or error code (negative).
+ */
+int libswd_bin_compare(const char *a, const char *b, int count){
+ if (a==NULL || b==NULL) return LIBSWD_ERROR_NULLPOINTER;
+ if (count<0) return LIBSWD_ERROR_PARAM;
+ int i=0;
+ unsigned long long wa, wb;
+ #if defined(__AVX2__)
+ __m256i eq;
+ for (; i+64<=count; i+=64)
+ {
+  eq=_mm256_and_si256(
+      _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a+i)), _mm256_loadu_si256((const __m256i*)(b+i))),
+      _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a+i+32)), _mm256_loadu_si256((const __m256i*)(b+i+32))) );
+  if ((unsigned int)_mm256_movemask_epi8(eq)!=0xFFFFFFFF) break;
+ }
+ #elif defined(__SSE2__)
+ __m128i eq;
+ for (; i+64<=count; i+=64)
+ {
+  eq=_mm_and_si128(
+      _mm_and_si128(
+       _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a+i)), _mm_loadu_si128((const __m128i*)(b+i))),
+       _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a+i+16)), _mm_loadu_si128((const __m128i*)(b+i+16))) ),
+      _mm_and_si128(
+       _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a+i+32)), _mm_loadu_si128((const __m128i*)(b+i+32))),
+       _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a+i+48)), _mm_loadu_si128((const __m128i*)(b+i+48))) ) );
+  if (_mm_movemask_epi8(eq)!=0xFFFF) break;
+ }
+ #endif
+ for (; i+8<=count; i+=8)
+ {
+  memcpy(&wa, a+i, 8);
+  memcpy(&wb, b+i, 8);
+  if (wa!=wb) break;
+ }
+ for (; i<count && a[i]==b[i]; i++);
+ return i;
+}
+
+
+/**
+ * Reverse byte order of every 32-bit word in the buffer, in place.
+ * Used to convert memory images between host and target byte order,
+ * whole buffer is swapped 32 or 16 bytes at a time with AVX2, SSSE3 or
+ * SSE2 when the compiler targets them. Buffer does not need to be aligned.
+ * \param *data buffer pointer.
+ * \param count number of 32-bit words.
+ * \return number of words swapped or error code (negative).
+ */
+int libswd_bin_bswap32(char *data, int count){
+ if (data==NULL) return LIBSWD_ERROR_NULLPOINTER;
+ if (count<0) return LIBSWD_ERROR_PARAM;
+ int i=0;
+ char tmp;
+ #if defined(__AVX2__)
+ const __m256i order=_mm256_set_epi8(12,13,14,15, 8,9,10,11, 4,5,6,7, 0,1,2,3,
+                                     12,13,14,15, 8,9,10,11, 4,5,6,7, 0,1,2,3);
+ for (; i+8<=count; i+=8)
+  _mm256_storeu_si256((__m256i*)(data+i*4), _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(data+i*4)), order));
+ #elif defined(__SSSE3__)
+ const __m128i order=_mm_set_epi8(12,13,14,15, 8,9,10,11, 4,5,6,7, 0,1,2,3);
+ for (; i+4<=count; i+=4)
+  _mm_storeu_si128((__m128i*)(data+i*4), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data+i*4)), order));
+ #elif defined(__SSE2__)
+ __m128i x;
+ for (; i+4<=count; i+=4)
+ {
+  // Swap bytes in halfwords, then halfwords in words.
+  x=_mm_loadu_si128((const __m128i*)(data+i*4));
+  x=_mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+  x=_mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(2,3,0,1)), _MM_SHUFFLE(2,3,0,1));
+  _mm_storeu_si128((__m128i*)(data+i*4), x);
+ }
+ #endif
+ for (; i<count; i++)
+ {
+  tmp=data[i*4];   data[i*4]=data[i*4+3];   data[i*4+3]=tmp;
+  tmp=data[i*4+1]; data[i*4+1]=data[i*4+2]; data[i*4+2]=tmp;
+ }
+ return count;
+}
+
+/**
+ * Check host byte order.
+ * \return 1 on big-endian host, 0 on little-endian host.
+ */
+int libswd_bin_bigendian(void){
+ unsigned int one=1;
+ return (*(unsigned char*)&one)?0:1;
+}
+
+#ifdef __PCLMUL__
+/**
+ * CRC-32 folding with carry-less multiply (PCLMULQDQ).
+ * Blocks are folded 64 bytes at a time, then reduced with Barrett
+ * reduction, constants are for the reflected 0xEDB88320 polynomial.
+ * This is the raw CRC, without initial and final inversion.
+ * \param crc raw CRC of previous data.
+ * \param *data source data pointer.
+ * \param count number of bytes, at least 64 and multiple of 16.
+ * \return raw CRC value.
+ */
+unsigned int libswd_bin_crc32_pclmul(unsigned int crc, const unsigned char *data, int count){
+ __m128i x1, x2, x3, x4, x5, k, mask;
+
+ x1=_mm_xor_si128(_mm_loadu_si128((const __m128i*)data), _mm_cvtsi32_si128((int)crc));
+ x2=_mm_loadu_si128((const __m128i*)(data+16));
+ x3=_mm_loadu_si128((const __m128i*)(data+32));
+ x4=_mm_loadu_si128((const __m128i*)(data+48));
+ data+=64;
+ count-=64;
+ // Fold four 128-bit lanes over next 64 bytes.
+ k=_mm_set_epi64x(0x1C6E41596LL, 0x154442BD4LL);
+ for (; count>=64; count-=64, data+=64)
+ {
+  x5=_mm_clmulepi64_si128(x1, k, 0x00);
+  x1=_mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k, 0x11), x5), _mm_loadu_si128((const __m128i*)data));
+  x5=_mm_clmulepi64_si128(x2, k, 0x00);
+  x2=_mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x2, k, 0x11), x5), _mm_loadu_si128((const __m128i*)(data+16)));
+  x5=_mm_clmulepi64_si128(x3, k, 0x00);
+  x3=_mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x3, k, 0x11), x5), _mm_loadu_si128((const __m128i*)(data+32)));
+  x5=_mm_clmulepi64_si128(x4, k, 0x00);
+  x4=_mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x4, k, 0x11), x5), _mm_loadu_si128((const __m128i*)(data+48)));
+ }
+ // Fold lanes into one, then remaining 16-byte blocks.
+ k=_mm_set_epi64x(0x0CCAA009ELL, 0x1751997D0LL);
+ x5=_mm_clmulepi64_si128(x1, k, 0x00);
+ x1=_mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k, 0x11), x5), x2);
+ x5=_mm_clmulepi64_si128(x1, k, 0x00);
+ x1=_mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k, 0x11), x5), x3);
+ x5=_mm_clmulepi64_si128(x1, k, 0x00);
+ x1=_mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k, 0x11), x5), x4);
+ for (; count>=16; count-=16, data+=16)
+ {
+  x5=_mm_clmulepi64_si128(x1, k, 0x00);
+  x1=_mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k, 0x11), x5), _mm_loadu_si128((const __m128i*)data));
+ }
+ // Reduce 128 to 64 bits, then 64 to 32 bits.
+ x2=_mm_srli_si128(x1, 8);
+ x1=_mm_xor_si128(_mm_clmulepi64_si128(x1, k, 0x10), x2);
+ mask=_mm_set_epi32(0, 0, 0, -1);
+ x2=_mm_srli_si128(x1, 4);
+ x1=_mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask), _mm_set_epi64x(0, 0x163CD6124LL), 0x00), x2);
+ // Barrett reduction to the final 32 bits.
+ k=_mm_set_epi64x(0x1F7011641LL, 0x1DB710641LL);
+ x2=x1;
+ x1=_mm_and_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask), k, 0x10), mask);
+ x1=_mm_xor_si128(_mm_clmulepi64_si128(x1, k, 0x00), x2);
+ return (unsigned int)_mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
+#endif
+
+/**
+ * CRC-32 (IEEE 802.3) of host data, zlib crc32() compatible.
+ * This is the host equivalent of libswd_stub_crc32() on-target routine.
+ * Uses PCLMULQDQ folding for blocks when compiler targets it, slicing by
+ * eight tables otherwise. Tables are built on the first call. Data is read
+ * byte by byte, so result does not depend on host endianness.
+ * \param crc checksum of previous data, 0 to start.
+ * \param *data source data pointer.
+ * \param count number of bytes.
+ * \return CRC-32 value.
+ */
+unsigned int libswd_bin_crc32(unsigned int crc, const char *data, int count){
+ static unsigned int table[8][256];
+ static int initialized;
+ const unsigned char *p=(const unsigned char*)data;
+ unsigned int c, lo, hi;
+ int i, j;
+ if (!initialized)
+ {
+  for (i=0; i<256; i++)
+  {
+   c=i;
+   for (j=0; j<8; j++) c=(c>>1)^(0xEDB88320&-(c&1));
+   table[0][i]=c;
+  }
+  for (i=0; i<256; i++)
+   for (j=1; j<8; j++)
+    table[j][i]=(table[j-1][i]>>8)^table[0][table[j-1][i]&0xFF];
+  initialized=1;
+ }
+ if (p==NULL || count<=0) return crc;
+ crc=~crc;
+ #ifdef __PCLMUL__
+ if (count>=64)
+ {
+  crc=libswd_bin_crc32_pclmul(crc, p, count&~15);
+  p+=count&~15;
+  count&=15;
+ }
+ #endif
+ for (; count>=8; count-=8, p+=8)
+ {
+  lo=(p[0]|(p[1]<<8)|(p[2]<<16)|((unsigned int)p[3]<<24))^crc;
+  hi=p[4]|(p[5]<<8)|(p[6]<<16)|((unsigned int)p[7]<<24);
+  crc=table[7][lo&0xFF]^table[6][(lo>>8)&0xFF]^table[5][(lo>>16)&0xFF]^table[4][lo>>24]
+     ^table[3][hi&0xFF]^table[2][(hi>>8)&0xFF]^table[1][(hi>>16)&0xFF]^table[0][hi>>24];
+ }
+ for (; count; count--, p++) crc=(crc>>8)^table[0][(crc^*p)&0xFF];
+ return ~crc;
+}
+
 /** @} */
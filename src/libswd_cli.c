@@ -52,6 +52,7 @@ int libswd_cli_print_usage(libswd_ctx_t *libswdctx)
  libswd_log(libswdctx, LIBSWD_LOGLEVEL_NORMAL, "LIBSWD_N:  [h]elp / [?]\n");
  libswd_log(libswdctx, LIBSWD_LOGLEVEL_NORMAL, "LIBSWD_N:  [i]nit [dap]|memap|debug\n");
  libswd_log(libswdctx, LIBSWD_LOGLEVEL_NORMAL, "LIBSWD_N:  [l]oglevel <newloglevel>\n");
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_NORMAL, "LIBSWD_N:  [s]tats <reset>\n");
  libswd_log(libswdctx, LIBSWD_LOGLEVEL_NORMAL, "LIBSWD_N:  [r]ead [d]ap/[a]p 0xAddress\n");
  libswd_log(libswdctx, LIBSWD_LOGLEVEL_NORMAL, "LIBSWD_N:  [w]rite [d]ap/[a]p 0xAddress 0x32BitData\n");
  libswd_log(libswdctx, LIBSWD_LOGLEVEL_NORMAL, "LIBSWD_N:  [r]ead [m]emap 0xAddress <0xCount>|4 <filename>\n");
@@ -134,6 +135,19 @@ int libswd_cli(libswd_ctx_t *libswdctx, char *command)
     continue;
    }
 
+   // Check for STATS invocation.
+   else if ( strncmp(cmd,"s",1)==0 || strncmp(cmd,"stats",5)==0 )
+   {
+    libswd_stats_print(libswdctx);
+    cmd=strsep(&thiscommand," ");
+    if (cmd && (strncmp(cmd,"r",1)==0 || strncmp(cmd,"reset",5)==0))
+    {
+     libswd_stats_reset(libswdctx);
+     libswd_log(libswdctx, LIBSWD_LOGLEVEL_NORMAL, "LIBSWD_N: Statistics cleared.\n");
+    }
+    continue;
+   }
+
    // Initialize Target subsystems.
    // This will bring components into known state and remove any pending errors.
    else if ( strncmp(cmd,"i",1)==0 || strncmp(cmd,"init",4)==0 )
@@ -266,6 +280,31 @@ int libswd_cli(libswd_ctx_t *libswdctx, char *command)
         filename=cmd;
        } else filename=NULL;
       } else filename=NULL;
+      // Stream result to a file if requested, without buffering whole region.
+      if (filename)
+      {
+       FILE *fp;
+       fp=fopen(filename,"w");
+       if (!fp)
+       {
+        libswd_log(libswdctx, LIBSWD_LOGLEVEL_WARNING,
+                   "LIBSWD_W: libswd_cli(): Cannot open '%s' data file (%s)!\n",
+                   filename, strerror(errno) );
+        break;
+       }
+       retval=libswd_memap_dump(libswdctx, addrstart, count, fp, 0);
+       if (fclose(fp))
+       {
+        libswd_log(libswdctx, LIBSWD_LOGLEVEL_WARNING,
+                   "LIBSWD_W: libswd_cli(): Cannot close data file '%s' (%s)!\n",
+                   filename, strerror(errno) );
+       }
+       if (retval<0) goto libswd_cli_error;
+       libswd_log(libswdctx, LIBSWD_LOGLEVEL_NORMAL,
+                  "LIBSWD_N: Stored %d bytes from 0x%08X to '%s'.\n",
+                  count, addrstart, filename );
+       break;
+      }
       // Take care of proper memory (re)allocation.
       if (libswdctx->membuf.size<count)
       {
@@ -282,35 +321,9 @@ int libswd_cli(libswd_ctx_t *libswdctx, char *command)
        } else memset((void*)libswdctx->membuf.data, 0xFF, libswdctx->membuf.size);
       } else libswdctx->membuf.size=count*sizeof(char);
       // Perform MEM-AP read.
-      retval=libswd_memap_read_char_32(libswdctx, LIBSWD_OPERATION_EXECUTE,
-                                       addrstart, count,
-                                       (char*)libswdctx->membuf.data );
+      retval=libswd_memap_read_any(libswdctx, addrstart, count,
+                                   (char*)libswdctx->membuf.data );
       if (retval<0) goto libswd_cli_error;
-      // Store result to a file if requested.
-      if (filename)
-      {
-       FILE *fp;
-       fp=fopen(filename,"w");
-       if (!fp)
-       {
-        libswd_log(libswdctx, LIBSWD_LOGLEVEL_WARNING,
-                   "LIBSWD_W: libswd_cli(): Cannot open '%s' data file!\n",
-                   filename, strerror(errno) );
-        break;
-       }
-       retval=fwrite(libswdctx->membuf.data, sizeof(char), count, fp);
-       if (!retval)
-        libswd_log(libswdctx, LIBSWD_LOGLEVEL_WARNING,
-                   "LIBSWD_W: libswd_cli(): Cannot write to data file '%s' (%s)!\n",
-                   filename, strerror(errno) );
-       retval=fclose(fp);
-       if (retval)
-       {
-        libswd_log(libswdctx, LIBSWD_LOGLEVEL_WARNING,
-                   "LIBSWD_W: libswd_cli(): Cannot close data file '%s' (%s)!\n",
-                   filename, strerror(errno) );
-       }
-      }
       // Print out the result.
       for (i=0; i<count; i=i+16)
       {
@@ -511,9 +524,8 @@ libswd_cli_write_memap_file_load_ok:
                   libswdctx->membuf.size, filename );
       }
       // At this point data are in membuf, sent them to MEM-AP.
-      retval=libswd_memap_write_char_32(libswdctx, LIBSWD_OPERATION_EXECUTE,
-                                        addrstart, libswdctx->membuf.size,
-                                        (char*)libswdctx->membuf.data );
+      retval=libswd_memap_write_any(libswdctx, addrstart, libswdctx->membuf.size,
+                                    (char*)libswdctx->membuf.data );
       if (retval<0) goto libswd_cli_error;
       // Print out the data.
       for (i=0; i<libswdctx->membuf.size; i=i+16)
@@ -475,6 +475,22 @@ int libswd_cmd_enqueue_mosi_swd2jtag(libswd_ctx_t *libswdctx){
  return libswd_cmd_enqueue_mosi_control(libswdctx, (char *)LIBSWD_CMD_SWD2JTAG, sizeof(LIBSWD_CMD_SWD2JTAG));
 }
 
+/** Append command queue with DORMANT-TO-SWD SWDv2 DAP wakeup sequence.
+ * \param *libswdctx swd context pointer.
+ * \return number of elements appended, or LIBSWD_ERROR_CODE on failure.
+ */
+int libswd_cmd_enqueue_mosi_dormant2swd(libswd_ctx_t *libswdctx){
+ return libswd_cmd_enqueue_mosi_control(libswdctx, (char *)LIBSWD_CMD_DORMANT2SWD, sizeof(LIBSWD_CMD_DORMANT2SWD));
+}
+
+/** Append command queue with SWD-TO-DORMANT SWDv2 DAP-switch sequence.
+ * \param *libswdctx swd context pointer.
+ * \return number of elements appended, or LIBSWD_ERROR_CODE on failure.
+ */
+int libswd_cmd_enqueue_mosi_swd2dormant(libswd_ctx_t *libswdctx){
+ return libswd_cmd_enqueue_mosi_control(libswdctx, (char *)LIBSWD_CMD_SWD2DORMANT, sizeof(LIBSWD_CMD_SWD2DORMANT));
+}
+
 /** Return human readable command type string of *cmd.
  * \param *cmd command the name is to be printed.
  * \return string containing human readable command name, or NULL on failure.
@@ -127,6 +127,7 @@ int libswd_cmdq_free(libswd_cmd_t *cmdq){
  cmd=libswd_cmdq_find_head(cmdq);
  while (cmd!=NULL) {
   nextcmd=cmd->next;
+  if (cmd->errors) libswd_cmdq_free(cmd->errors);
   free(cmd);
   cmd=nextcmd;
   cmdcnt++;
@@ -145,6 +146,7 @@ int libswd_cmdq_free_head(libswd_cmd_t *cmdq){
  cmdqroot=libswd_cmdq_find_head(cmdq);
  while(cmdqroot!=cmdq){
   nextcmd=cmdqroot->next;
+  if (cmdqroot->errors) libswd_cmdq_free(cmdqroot->errors);
   free(cmdqroot);
   cmdqroot=nextcmd;
   cmdcnt++;
@@ -166,6 +168,7 @@ int libswd_cmdq_free_tail(libswd_cmd_t *cmdq){
  if (cmdqend==NULL) return LIBSWD_ERROR_QUEUE;
  while(cmdqend!=cmdq){
   cmdqend=cmdqend->prev;
+  if (cmdqend->next->errors) libswd_cmdq_free(cmdqend->next->errors);
   free(cmdqend->next);
   cmdcnt++;
  }
@@ -223,12 +226,17 @@ int libswd_cmdq_flush(libswd_ctx_t *libswdctx, libswd_cmd_t **cmdq, libswd_opera
  if (firstcmd==NULL) return LIBSWD_ERROR_QUEUEROOT;
  if (lastcmd==NULL) return LIBSWD_ERROR_QUEUETAIL;
 
+ // Every flush waits for the interface, count it as a round trip.
+ libswdctx->stats.roundtrips++;
+ libswd_stats_enter(libswdctx, LIBSWD_STATS_CLASS_BUS);
+
  if (firstcmd==lastcmd){
   if (!firstcmd->done) {
    res=libswd_drv_transmit(libswdctx, firstcmd);
-   if (res<0) return res;
+   if (res<0) goto libswd_cmdq_flush_error;
    *cmdq=firstcmd;
   }
+  libswd_stats_leave(libswdctx, LIBSWD_STATS_CLASS_BUS);
   return 1;
  }
 
@@ -239,12 +247,17 @@ int libswd_cmdq_flush(libswd_ctx_t *libswdctx, libswd_cmd_t **cmdq, libswd_opera
    } else break;
   }
   res=libswd_drv_transmit(libswdctx, cmd);
-  if (res<0) return res;
+  if (res<0) goto libswd_cmdq_flush_error;
   cmdcnt=+res;
   if (cmd==lastcmd) break;
  }
  *cmdq=cmd;
+ libswd_stats_leave(libswdctx, LIBSWD_STATS_CLASS_BUS);
  return cmdcnt;
+
+libswd_cmdq_flush_error:
+ libswd_stats_leave(libswdctx, LIBSWD_STATS_CLASS_BUS);
+ return res;
 }
 
 /** @} */
@@ -66,6 +66,15 @@ libswd_ctx_t *libswd_init(void){
  libswdctx->config.maxcmdqlen=LIBSWD_CMDQLEN_DEFAULT;
  libswdctx->config.loglevel=LIBSWD_LOGLEVEL_DEFAULT;
  libswdctx->config.autofixerrors=LIBSWD_AUTOFIX_DEFAULT;
+ libswdctx->config.waitidle=LIBSWD_WAIT_IDLE_DEFAULT;
+ libswdctx->config.waitdelay=LIBSWD_WAIT_DELAY_DEFAULT;
+ libswdctx->config.waitdelaymax=LIBSWD_WAIT_DELAYMAX_DEFAULT;
+ libswdctx->config.waittimeout=LIBSWD_WAIT_TIMEOUT_DEFAULT;
+ libswdctx->config.memapresume=LIBSWD_MEMAP_RESUME_DEFAULT;
+ libswdctx->config.matchretry=LIBSWD_MATCH_RETRY_DEFAULT;
+ libswdctx->config.stubtimeout=LIBSWD_STUB_TIMEOUT_DEFAULT;
+ libswdctx->statsctl.interval=LIBSWD_STATS_PROGRESS_DEFAULT;
+ libswdctx->multidrop.current=-1;
  libswd_log(libswdctx, LIBSWD_LOGLEVEL_NORMAL, "LIBSWD_N: Using " PACKAGE_STRING " (http://libswd.sf.net)\nLIBSWD_N: (c) Tomasz Boleslaw CEDRO (http://www.tomek.cedro.info)\n");
  return libswdctx;
 }
@@ -77,6 +86,17 @@ libswd_ctx_t *libswd_init(void){
  */
 int libswd_deinit_ctx(libswd_ctx_t *libswdctx){
  if (libswdctx==NULL) return LIBSWD_ERROR_NULLPOINTER;
+ int i;
+ libswd_target_job_t *job;
+ for (i=0;i<libswdctx->multidrop.count;i++){
+  while ((job=libswdctx->multidrop.target[i].jobs)){
+   libswdctx->multidrop.target[i].jobs=job->next;
+   free(job);
+  }
+ }
+ if (libswdctx->multidrop.target) free(libswdctx->multidrop.target);
+ if (libswdctx->results.slot) free(libswdctx->results.slot);
+ libswd_memcache_disable(libswdctx);
  free(libswdctx);
  return LIBSWD_OK;
 }
@@ -67,6 +67,8 @@ int libswd_dap_init(libswd_ctx_t *libswdctx, libswd_operation_t operation, int *
  dpctrlstat|=LIBSWD_DP_CTRLSTAT_CSYSPWRUPREQ;
  dpctrlstat|=LIBSWD_DP_CTRLSTAT_CDBGPWRUPREQ;
  libswdctx->log.dp.initialized=0;
+ // Target could have been reset or running meanwhile.
+ libswd_memcache_flush(libswdctx);
  res=libswd_dap_detect(libswdctx, operation, idcode);
  if (res<0) return res;
  res=libswd_dap_setup(libswdctx, operation, &dpabort, &dpctrlstat);
@@ -258,6 +260,90 @@ int libswd_dap_errors_handle(libswd_ctx_t *libswdctx, libswd_operation_t operati
 }
 
 
+/** ACK WAIT policy engine: reissue identical request until it is accepted.
+ * WAIT only means the AP is still busy, so sticky flags are left untouched
+ * and the same request is sent again after config.waitidle idle cycles,
+ * with exponential backoff starting from config.waitdelay up to
+ * config.waitdelaymax microseconds. When ORUNDETECT is set WAIT also sets
+ * STICKYORUN, so only ORUNERRCLR is written to ABORT in the same flush.
+ * When config.waittimeout deadline is reached the stalled transaction is
+ * cancelled with DAPABORT. Statistics are collected in libswdctx->stats.
+ * \param *libswdctx swd context to work on.
+ * \param request is the raw request that got ACK WAIT.
+ * \param *wdata data to write if request is a write.
+ * \param **rdata will point to the read result if request is a read.
+ * \param **rparity will point to the read result parity if request is a read.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_dap_retry_wait(libswd_ctx_t *libswdctx, char request, int *wdata, int **rdata, char **rparity){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG, "LIBSWD_D: libswd_dap_retry_wait(*libswdctx=%p, request=0x%02X, *wdata=%p, **rdata=%p, **rparity=%p) entering function...\n", (void*)libswdctx, (unsigned char)request, (void*)wdata, (void*)rdata, (void*)rparity);
+
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ char RnW=(request&LIBSWD_REQUEST_RnW)?1:0;
+ if (RnW && (rdata==NULL || rparity==NULL)) return LIBSWD_ERROR_NULLPOINTER;
+ if (!RnW && wdata==NULL) return LIBSWD_ERROR_NULLPOINTER;
+
+ int res, i, retry, abort, delay=libswdctx->config.waitdelay;
+ long elapsed=0;
+ char *ack;
+ struct timeval tstart, tnow;
+
+ gettimeofday(&tstart, NULL);
+ for (retry=1;;retry++){
+  libswdctx->stats.retries++;
+  // Idle cycles give the AP time to complete pending transfer.
+  for (i=0;i<libswdctx->config.waitidle;i+=LIBSWD_DATA_BYTESIZE){
+   res=libswd_bus_write_control(libswdctx, LIBSWD_OPERATION_ENQUEUE, (char*)LIBSWD_CMD_IDLE, sizeof(LIBSWD_CMD_IDLE));
+   if (res<0) goto libswd_dap_retry_wait_error;
+  }
+  // With overrun detection WAIT sets STICKYORUN that would FAULT the retry.
+  if (libswdctx->log.dp.ctrlstat&LIBSWD_DP_CTRLSTAT_ORUNDETECT){
+   abort=LIBSWD_DP_ABORT_ORUNERRCLR;
+   res=libswd_dp_write(libswdctx, LIBSWD_OPERATION_ENQUEUE, LIBSWD_DP_ABORT_ADDR, &abort);
+   if (res<0) goto libswd_dap_retry_wait_error;
+  }
+  res=libswd_bus_write_request_raw(libswdctx, LIBSWD_OPERATION_ENQUEUE, &request);
+  if (res<0) goto libswd_dap_retry_wait_error;
+  res=libswd_bus_read_ack(libswdctx, LIBSWD_OPERATION_EXECUTE, &ack);
+  gettimeofday(&tnow, NULL);
+  elapsed=(tnow.tv_sec-tstart.tv_sec)*1000000+(tnow.tv_usec-tstart.tv_usec);
+  if (res>=0){
+   if (RnW){
+    res=libswd_bus_read_data_p(libswdctx, LIBSWD_OPERATION_EXECUTE, rdata, rparity);
+   } else res=libswd_bus_write_data_ap(libswdctx, LIBSWD_OPERATION_EXECUTE, wdata);
+   if (res<0) goto libswd_dap_retry_wait_error;
+   break;
+  }
+  if (res!=LIBSWD_ERROR_ACK_WAIT) goto libswd_dap_retry_wait_error;
+  if (elapsed>=libswdctx->config.waittimeout){
+   // Deadline reached, cancel stalled AP transaction.
+   libswd_log(libswdctx, LIBSWD_LOGLEVEL_WARNING, "LIBSWD_W: libswd_dap_retry_wait(): ACK WAIT for %ldus after %d retries, issuing DAPABORT!\n", elapsed, retry);
+   abort=LIBSWD_DP_ABORT_DAPABORT|LIBSWD_DP_ABORT_ORUNERRCLR;
+   libswd_dp_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_DP_ABORT_ADDR, &abort);
+   libswdctx->stats.aborts++;
+   res=LIBSWD_ERROR_TIMEOUT;
+   goto libswd_dap_retry_wait_error;
+  }
+  if (delay>0){
+   usleep(delay);
+   delay*=2;
+   if (delay>libswdctx->config.waitdelaymax) delay=libswdctx->config.waitdelaymax;
+  }
+ }
+
+ libswdctx->stats.recovered++;
+ if ((unsigned long)retry>libswdctx->stats.maxretries) libswdctx->stats.maxretries=retry;
+ libswdctx->stats.waittime+=elapsed;
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG, "LIBSWD_D: libswd_dap_retry_wait(): request 0x%02X accepted after %d retries (%ldus).\n", (unsigned char)request, retry, elapsed);
+ return LIBSWD_OK;
+
+libswd_dap_retry_wait_error:
+ libswdctx->stats.waittime+=elapsed;
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR, "LIBSWD_E: libswd_dap_retry_wait(libswdctx=@%p, request=0x%02X) failed: %s.\n", (void*)libswdctx, (unsigned char)request, libswd_error_string(res));
+ return res;
+}
+
+
 /** Macro: Read out IDCODE register and return its value on function return.
  * \param *libswdctx swd context pointer.
  * \param operation operation type.
@@ -326,6 +412,388 @@ int libswd_dap_detect(libswd_ctx_t *libswdctx, libswd_operation_t operation, int
 }
 
 
+/** Set the CTRL/STAT TRNMODE and MASKLANE fields for pushed operations.
+ * While TRNMODE is not LIBSWD_TRNMODE_NORMAL every AP write is turned into
+ * read and compare on target, so restore normal mode before other AP writes.
+ * \param *libswdctx swd context to work on.
+ * \param operation can be LIBSWD_OPERATION_ENQUEUE or LIBSWD_OPERATION_EXECUTE.
+ * \param trnmode is one of LIBSWD_TRNMODE_* values.
+ * \param masklane selects compared byte lanes, see LIBSWD_MASKLANE_*.
+ * \return number of elements processed or LIBSWD_ERROR code on failure.
+ */
+int libswd_dap_trnmode(libswd_ctx_t *libswdctx, libswd_operation_t operation, int trnmode, int masklane){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG, "LIBSWD_D: libswd_dap_trnmode(*libswdctx=%p, operation=%s, trnmode=%d, masklane=0x%X) entering function...\n", (void*)libswdctx, libswd_operation_string(operation), trnmode, masklane);
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (trnmode!=LIBSWD_TRNMODE_NORMAL && trnmode!=LIBSWD_TRNMODE_PUSHEDVERIFY && trnmode!=LIBSWD_TRNMODE_PUSHEDCOMPARE)
+  return LIBSWD_ERROR_PARAM;
+ int res, ctrlstat, cached=libswdctx->log.dp.ctrlstat;
+ // Keep the request bits, sticky flags are read-only on SW-DP.
+ ctrlstat=cached&(LIBSWD_DP_CTRLSTAT_CSYSPWRUPREQ|LIBSWD_DP_CTRLSTAT_CDBGPWRUPREQ|LIBSWD_DP_CTRLSTAT_ORUNDETECT);
+ ctrlstat|=trnmode<<LIBSWD_DP_CTRLSTAT_TRNMODE_BITNUM;
+ ctrlstat|=(masklane<<LIBSWD_DP_CTRLSTAT_MASKLANE_BITNUM)&LIBSWD_DP_CTRLSTAT_MASKLANE;
+ res=libswd_dp_write(libswdctx, operation, LIBSWD_DP_CTRLSTAT_ADDR, &ctrlstat);
+ if (res<0) return res;
+ libswdctx->log.dp.ctrlstat=(cached&~(LIBSWD_DP_CTRLSTAT_TRNMODE|LIBSWD_DP_CTRLSTAT_MASKLANE))|ctrlstat;
+ return res;
+}
+
+
+/** Save DAP and MEM-AP state into the session descriptor.
+ * Use libswd_dap_reconnect() with this descriptor for fast reconnect.
+ * \param *libswdctx swd context to work on.
+ * \param *session is the session descriptor to fill.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_dap_session_save(libswd_ctx_t *libswdctx, libswd_session_t *session){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (session==NULL) return LIBSWD_ERROR_NULLPOINTER;
+ if (!libswdctx->log.dp.initialized) return LIBSWD_ERROR_NOTDONE;
+ memset(session, 0, sizeof(libswd_session_t));
+ session->idcode=libswdctx->log.dp.idcode;
+ session->ctrlstat=libswdctx->log.dp.ctrlstat;
+ session->select=libswdctx->log.dp.select;
+ session->ap=libswdctx->aptable.current;
+ session->memap=libswdctx->log.memap;
+ session->magic=LIBSWD_SESSION_MAGIC;
+ return LIBSWD_OK;
+}
+
+
+/** Macro: Fast reconnect to the target using saved session descriptor.
+ * Line reset, IDCODE read, CTRL/STAT read and SELECT write are sent in a
+ * single queue flush. If IDCODE matches the session, debug and system power
+ * is still acknowledged and no sticky errors are set, the DP and MEM-AP
+ * state is restored from the session, skipping JTAG-TO-SWD, power-up
+ * polling, MEM-AP IDR/BASE reads and CSW setup. CSW is read back and TAR
+ * is marked unknown, as they may have changed meanwhile. Otherwise (or when session
+ * is NULL or invalid) full libswd_dap_init() is performed.
+ * \param *libswdctx swd context to work on.
+ * \param *session is the session descriptor saved with libswd_dap_session_save().
+ * \param **idcode will point to the target's IDCODE.
+ * \return LIBSWD_TRUE on fast reconnect, LIBSWD_FALSE on full init, or LIBSWD_ERROR code on failure.
+ */
+int libswd_dap_reconnect(libswd_ctx_t *libswdctx, libswd_session_t *session, int **idcode){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG,
+            "LIBSWD_D: libswd_dap_reconnect(*libswdctx=@%p, *session=@%p, **idcode=@%p) entring function...\n",
+            (void*)libswdctx, (void*)session, (void**)idcode );
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (idcode==NULL) return LIBSWD_ERROR_NULLPOINTER;
+
+ int res, select, *ctrlstat, *csw;
+ char APnDP=0, RnW=1, idcode_addr=LIBSWD_DP_IDCODE_ADDR, ctrlstat_addr=LIBSWD_DP_CTRLSTAT_ADDR;
+ char request, *ack, *parity;
+
+ if (session==NULL || session->magic!=LIBSWD_SESSION_MAGIC) goto libswd_dap_reconnect_full;
+
+ // Target could have been reset or running meanwhile.
+ libswd_memcache_flush(libswdctx);
+ libswdctx->log.dp.initialized=0;
+ res=libswd_dap_reset(libswdctx, LIBSWD_OPERATION_ENQUEUE);
+ if (res<0) return res;
+ res=libswd_bitgen8_request(libswdctx, &APnDP, &RnW, &idcode_addr, &request);
+ if (res<0) return res;
+ res=libswd_bus_write_request_raw(libswdctx, LIBSWD_OPERATION_ENQUEUE, &request);
+ if (res<0) return res;
+ res=libswd_bus_read_ack(libswdctx, LIBSWD_OPERATION_ENQUEUE, &ack);
+ if (res<0) return res;
+ res=libswd_bus_read_data_p(libswdctx, LIBSWD_OPERATION_ENQUEUE, idcode, &parity);
+ if (res<0) return res;
+ res=libswd_bitgen8_request(libswdctx, &APnDP, &RnW, &ctrlstat_addr, &request);
+ if (res<0) return res;
+ res=libswd_bus_write_request_raw(libswdctx, LIBSWD_OPERATION_ENQUEUE, &request);
+ if (res<0) return res;
+ res=libswd_bus_read_ack(libswdctx, LIBSWD_OPERATION_ENQUEUE, &ack);
+ if (res<0) return res;
+ res=libswd_bus_read_data_p(libswdctx, LIBSWD_OPERATION_ENQUEUE, &ctrlstat, &parity);
+ if (res<0) return res;
+ // SELECT write does no harm if we fall back to full init.
+ select=session->select;
+ res=libswd_dp_write(libswdctx, LIBSWD_OPERATION_ENQUEUE, LIBSWD_DP_SELECT_ADDR, &select);
+ if (res<0) return res;
+ res=libswd_cmdq_flush(libswdctx, &libswdctx->cmdq, LIBSWD_OPERATION_EXECUTE);
+ if (res<0){
+  libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO, "LIBSWD_I: libswd_dap_reconnect(): link is down (%s).\n", libswd_error_string(res));
+  goto libswd_dap_reconnect_full;
+ }
+ if (**idcode!=session->idcode){
+  libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO, "LIBSWD_I: libswd_dap_reconnect(): IDCODE=0x%08X does not match session.\n", **idcode);
+  goto libswd_dap_reconnect_full;
+ }
+ if ((*ctrlstat&(LIBSWD_DP_CTRLSTAT_CDBGPWRUPACK|LIBSWD_DP_CTRLSTAT_CSYSPWRUPACK))!=(LIBSWD_DP_CTRLSTAT_CDBGPWRUPACK|LIBSWD_DP_CTRLSTAT_CSYSPWRUPACK)
+     || (*ctrlstat&(LIBSWD_DP_CTRLSTAT_STICKYORUN|LIBSWD_DP_CTRLSTAT_STICKYCMP|LIBSWD_DP_CTRLSTAT_STICKYERR|LIBSWD_DP_CTRLSTAT_WDATAERR))){
+  libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO, "LIBSWD_I: libswd_dap_reconnect(): DP CTRL/STAT=0x%08X not usable.\n", *ctrlstat);
+  goto libswd_dap_reconnect_full;
+ }
+
+ // Link is alive, restore the session state.
+ libswdctx->log.dp.idcode=**idcode;
+ libswdctx->log.dp.ctrlstat=*ctrlstat;
+ libswdctx->log.dp.select=session->select;
+ libswdctx->log.dp.initialized=1;
+ libswdctx->log.memap=session->memap;
+ libswdctx->aptable.current=session->ap;
+ // Another tool or reset could change CSW and TAR while link was down,
+ // so CSW is read back and TAR (also BD window) is not trusted.
+ libswdctx->log.memap.tar=LIBSWD_MEMAP_TAR_UNKNOWN;
+ if (libswdctx->log.memap.initialized){
+  res=libswd_ap_read(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_CSW_ADDR, &csw);
+  if (res<0){
+   libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO, "LIBSWD_I: libswd_dap_reconnect(): cannot read MEM-AP CSW (%s).\n", libswd_error_string(res));
+   goto libswd_dap_reconnect_full;
+  }
+  libswdctx->log.memap.csw=*csw;
+ }
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO, "LIBSWD_I: libswd_dap_reconnect(): fast reconnect OK, IDCODE=0x%08X CTRL/STAT=0x%08X.\n", **idcode, *ctrlstat);
+ return LIBSWD_TRUE;
+
+libswd_dap_reconnect_full:
+ libswdctx->log.memap.initialized=0;
+ res=libswd_dap_init(libswdctx, LIBSWD_OPERATION_EXECUTE, idcode);
+ if (res<0) return res;
+ return LIBSWD_FALSE;
+}
+
+
+/** Wake up SWDv2 DAP(s) from Dormant state into SWD and perform line reset.
+ * Dormant state is default for SWDv2 multi-drop targets. After wakeup all
+ * targets on the bus are in reset state, so one of them must be selected
+ * with TARGETSEL write (see libswd_dap_target_select()) before any access.
+ * \param *libswdctx swd context pointer.
+ * \param operation type (LIBSWD_OPERATION_ENQUEUE or LIBSWD_OPERATION_EXECUTE).
+ * \return number of elements processed or LIBSWD_ERROR_CODE code on failure.
+ */
+int libswd_dap_dormant_wakeup(libswd_ctx_t *libswdctx, libswd_operation_t operation){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG,
+            "LIBSWD_D: Executing libswd_dap_dormant_wakeup(*libswdctx=@%p, operation=%s)\n",
+            (void*)libswdctx, libswd_operation_string(operation) );
+
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (operation!=LIBSWD_OPERATION_ENQUEUE && operation!=LIBSWD_OPERATION_EXECUTE)
+  return LIBSWD_ERROR_BADOPCODE;
+
+ int res, qcmdcnt=0, tcmdcnt=0;
+ libswdctx->log.dp.initialized=0;
+ libswdctx->multidrop.current=-1;
+ res=libswd_bus_setdir_mosi(libswdctx);
+ if (res<0) return res;
+ res=libswd_cmd_enqueue_mosi_dormant2swd(libswdctx);
+ if (res<1) return res;
+ qcmdcnt+=res;
+ res=libswd_dap_reset(libswdctx, LIBSWD_OPERATION_ENQUEUE);
+ if (res<1) return res;
+ qcmdcnt+=res;
+
+ if (operation==LIBSWD_OPERATION_ENQUEUE)
+ {
+  return qcmdcnt;
+ }
+ else if (operation==LIBSWD_OPERATION_EXECUTE)
+ {
+  res=libswd_cmdq_flush(libswdctx, &libswdctx->cmdq, operation);
+  if (res<0) return res;
+  tcmdcnt+=res;
+  return qcmdcnt+tcmdcnt;
+ }
+ else return LIBSWD_ERROR_BADOPCODE;
+}
+
+
+/** Macro function: Write DP TARGETSEL register (SWDv2 multi-drop).
+ * TARGETSEL write must follow line reset. Targets do not drive the ACK
+ * for this write, so ACK bits are clocked in but not verified.
+ * \param *libswdctx swd context to work on.
+ * \param operation can be LIBSWD_OPERATION_ENQUEUE or LIBSWD_OPERATION_EXECUTE.
+ * \param *targetsel is the pointer to TARGETSEL value to be written.
+ * \return number of elements processed or LIBSWD_ERROR code on failure.
+ */
+int libswd_dp_targetsel(libswd_ctx_t *libswdctx, libswd_operation_t operation, int *targetsel){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG, "LIBSWD_D: libswd_dp_targetsel(*libswdctx=%p, operation=%s, *targetsel=%p) entering function...\n", (void*)libswdctx, libswd_operation_string(operation), (void*)targetsel);
+
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (targetsel==NULL) return LIBSWD_ERROR_NULLPOINTER;
+ if (operation!=LIBSWD_OPERATION_ENQUEUE && operation!=LIBSWD_OPERATION_EXECUTE)
+  return LIBSWD_ERROR_BADOPCODE;
+
+ int res, cmdcnt=0;
+ char APnDP=0, RnW=0, addr=LIBSWD_DP_TARGETSEL_ADDR, request;
+
+ res=libswd_bitgen8_request(libswdctx, &APnDP, &RnW, &addr, &request);
+ if (res<0) return res;
+ res=libswd_bus_write_request_raw(libswdctx, LIBSWD_OPERATION_ENQUEUE, &request);
+ if (res<1) return res;
+ cmdcnt+=res;
+ // ACK is not driven by targets, read its bits without verification.
+ res=libswd_bus_setdir_miso(libswdctx);
+ if (res<0) return res;
+ cmdcnt+=res;
+ res=libswd_cmd_enqueue_miso_nbit(libswdctx, NULL, LIBSWD_ACK_BITLEN);
+ if (res<1) return res;
+ cmdcnt+=res;
+ res=libswd_bus_write_data_ap(libswdctx, operation, targetsel);
+ if (res<0) {
+  libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR, "LIBSWD_E: libswd_dp_targetsel(libswdctx=@%p, operation=%s, *targetsel=0x%08X) failed: %s.\n", (void*)libswdctx, libswd_operation_string(operation), *targetsel, libswd_error_string(res));
+  return res;
+ }
+ cmdcnt+=res;
+ if (operation==LIBSWD_OPERATION_EXECUTE) libswdctx->log.dp.targetsel=*targetsel;
+ return cmdcnt;
+}
+
+
+/** Add SWDv2 multi-drop target to the context.
+ * Each target gets its own sub-context that keeps its DP/AP state.
+ * \param *libswdctx swd context to work on.
+ * \param targetsel is the TARGETSEL value of the target.
+ * \return index of the new target or LIBSWD_ERROR code on failure.
+ */
+int libswd_dap_target_add(libswd_ctx_t *libswdctx, int targetsel){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ libswd_target_t *target;
+ target=(libswd_target_t*)realloc(libswdctx->multidrop.target, (libswdctx->multidrop.count+1)*sizeof(libswd_target_t));
+ if (target==NULL) return LIBSWD_ERROR_OUTOFMEM;
+ libswdctx->multidrop.target=target;
+ target=&libswdctx->multidrop.target[libswdctx->multidrop.count];
+ memset(target, 0, sizeof(libswd_target_t));
+ target->targetsel=targetsel;
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG, "LIBSWD_D: libswd_dap_target_add(): target %d TARGETSEL=0x%08X.\n", libswdctx->multidrop.count, targetsel);
+ return libswdctx->multidrop.count++;
+}
+
+
+/** Select SWDv2 multi-drop target.
+ * Line reset, TARGETSEL write and IDCODE read are sent in one queue flush,
+ * then state of the previous target is saved into its sub-context and state
+ * of the selected target is restored from its sub-context. DP is powered
+ * up and setup on first selection of the target. MEM-AP read cache is
+ * flushed on every target switch, also when switched by libswd_dap_target_run().
+ * \param *libswdctx swd context to work on.
+ * \param target is the index returned by libswd_dap_target_add().
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_dap_target_select(libswd_ctx_t *libswdctx, int target){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG, "LIBSWD_D: libswd_dap_target_select(*libswdctx=%p, target=%d) entering function...\n", (void*)libswdctx, target);
+
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (target<0 || target>=libswdctx->multidrop.count) return LIBSWD_ERROR_PARAM;
+ if (target==libswdctx->multidrop.current) return LIBSWD_OK;
+
+ int res, *idcode, abort, ctrlstat, select;
+ libswd_target_t *t;
+
+ // Save state of the currently selected target.
+ if (libswdctx->multidrop.current>=0){
+  t=&libswdctx->multidrop.target[libswdctx->multidrop.current];
+  t->dp=libswdctx->log.dp;
+  t->memap=libswdctx->log.memap;
+  t->debug=libswdctx->log.debug;
+  t->aptable=libswdctx->aptable;
+ }
+ libswdctx->multidrop.current=-1;
+ // Cache pages are not tagged with the target, drop them on every switch.
+ libswd_memcache_flush(libswdctx);
+
+ t=&libswdctx->multidrop.target[target];
+ res=libswd_dap_reset(libswdctx, LIBSWD_OPERATION_ENQUEUE);
+ if (res<0) goto libswd_dap_target_select_error;
+ res=libswd_dp_targetsel(libswdctx, LIBSWD_OPERATION_ENQUEUE, &t->targetsel);
+ if (res<0) goto libswd_dap_target_select_error;
+ res=libswd_dp_read_idcode(libswdctx, LIBSWD_OPERATION_EXECUTE, &idcode);
+ if (res<0) goto libswd_dap_target_select_error;
+
+ // Restore state of the selected target.
+ libswdctx->log.dp=t->dp;
+ libswdctx->log.memap=t->memap;
+ libswdctx->log.debug=t->debug;
+ libswdctx->aptable=t->aptable;
+ libswdctx->log.dp.idcode=t->idcode=*idcode;
+ libswdctx->log.dp.targetsel=t->targetsel;
+
+ if (!libswdctx->log.dp.initialized){
+  // First selection, power up and setup the DP.
+  abort=~0;
+  ctrlstat=LIBSWD_DP_CTRLSTAT_ORUNDETECT|LIBSWD_DP_CTRLSTAT_CSYSPWRUPREQ|LIBSWD_DP_CTRLSTAT_CDBGPWRUPREQ;
+  res=libswd_dap_setup(libswdctx, LIBSWD_OPERATION_EXECUTE, &abort, &ctrlstat);
+  if (res<0) goto libswd_dap_target_select_error;
+  select=0;
+  libswdctx->log.dp.initialized=1;
+ } else select=libswdctx->log.dp.select;
+ // SELECT is not guaranteed to survive the line reset, write it again.
+ res=libswd_dp_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_DP_SELECT_ADDR, &select);
+ if (res<0) goto libswd_dap_target_select_error;
+ // Target counts as selected only when fully setup, so failed selection is retried.
+ libswdctx->multidrop.current=target;
+
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO, "LIBSWD_I: libswd_dap_target_select(): target %d TARGETSEL=0x%08X IDCODE=0x%08X selected.\n", target, t->targetsel, t->idcode);
+ return LIBSWD_OK;
+
+libswd_dap_target_select_error:
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR, "LIBSWD_E: libswd_dap_target_select(libswdctx=@%p, target=%d) failed: %s.\n", (void*)libswdctx, target, libswd_error_string(res));
+ return res;
+}
+
+
+/** Schedule operation for SWDv2 multi-drop target.
+ * Operations are not executed until libswd_dap_target_run() is called.
+ * \param *libswdctx swd context to work on.
+ * \param target is the index returned by libswd_dap_target_add().
+ * \param *fn is the operation, called with libswd_ctx_t pointer and *arg.
+ * \param *arg is the operation argument.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_dap_target_schedule(libswd_ctx_t *libswdctx, int target, int (*fn)(void *libswdctx, void *arg), void *arg){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (fn==NULL) return LIBSWD_ERROR_NULLPOINTER;
+ if (target<0 || target>=libswdctx->multidrop.count) return LIBSWD_ERROR_PARAM;
+ libswd_target_job_t *job, **tail;
+ job=(libswd_target_job_t*)calloc(1, sizeof(libswd_target_job_t));
+ if (job==NULL) return LIBSWD_ERROR_OUTOFMEM;
+ job->fn=fn;
+ job->arg=arg;
+ for (tail=&libswdctx->multidrop.target[target].jobs; *tail; tail=&(*tail)->next);
+ *tail=job;
+ return LIBSWD_OK;
+}
+
+
+/** Run operations scheduled for SWDv2 multi-drop targets.
+ * Operations are batched per target, so TARGETSEL switch only happens
+ * between batches, never between operations. Batch of the currently
+ * selected target goes first to save one switch. Operations of each target
+ * run in order of scheduling. Operation is removed from the schedule
+ * once it succeeds, so on failure the failing operation and all remaining
+ * operations stay scheduled and error is returned.
+ * \param *libswdctx swd context to work on.
+ * \return number of operations executed or LIBSWD_ERROR code on failure.
+ */
+int libswd_dap_target_run(libswd_ctx_t *libswdctx){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+
+ int i, target, first, res, jobs=0;
+ libswd_target_job_t *job;
+
+ first=libswdctx->multidrop.current;
+ for (i=-1;i<libswdctx->multidrop.count;i++){
+  target=(i<0)?first:i;
+  if (target<0 || (i>=0 && i==first)) continue;
+  if (!libswdctx->multidrop.target[target].jobs) continue;
+  res=libswd_dap_target_select(libswdctx, target);
+  if (res<0) goto libswd_dap_target_run_error;
+  while ((job=libswdctx->multidrop.target[target].jobs)){
+   res=job->fn(libswdctx, job->arg);
+   if (res<0) goto libswd_dap_target_run_error;
+   libswdctx->multidrop.target[target].jobs=job->next;
+   free(job);
+   jobs++;
+  }
+ }
+ return jobs;
+
+libswd_dap_target_run_error:
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR, "LIBSWD_E: libswd_dap_target_run(libswdctx=@%p): target %d operation failed: %s.\n", (void*)libswdctx, target, libswd_error_string(res));
+ return res;
+}
+
+
 /** Macro: Generic read of the DP register.
  * When operation is LIBSWD_OPERATION_EXECUTE it also caches register values.
  * \param *libswdctx swd context to work on.
@@ -373,23 +841,12 @@ int libswd_dp_read(libswd_ctx_t *libswdctx, libswd_operation_t operation, char a
    if (cparity!=*parity) return LIBSWD_ERROR_PARITY;
    cmdcnt=+res;
   } else if (res==LIBSWD_ERROR_ACK_WAIT) {
-   //We got ACK==WAIT, retry last transfer until success or failure.
-   int retry, ctrlstat, abort;
-   for (retry=LIBSWD_RETRY_COUNT_DEFAULT; retry>0; retry--){
-    abort=0xFFFFFFFE;
-    res=libswd_dap_errors_handle(libswdctx, LIBSWD_OPERATION_EXECUTE, &abort, &ctrlstat);
-    if (res<0) continue;
-    res=libswd_bus_write_request_raw(libswdctx, LIBSWD_OPERATION_ENQUEUE, &request);
-    if (res<0) continue;
-    res=libswd_bus_read_ack(libswdctx, LIBSWD_OPERATION_EXECUTE, &ack);
-    if (res<0) continue;
-    res=libswd_bus_read_data_p(libswdctx, LIBSWD_OPERATION_EXECUTE, data, &parity);
-    if (res<0) continue;
-    res=libswd_dp_read(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_DP_RDBUFF_ADDR, data);
-    if (res<0) continue;
-    break;
+   //We got ACK==WAIT, reissue identical request according to WAIT policy.
+   res=libswd_dap_retry_wait(libswdctx, request, NULL, data, &parity);
+   if (res>=0){
+    res=libswd_bin32_parity_even(*data, &cparity);
+    if (res>=0 && cparity!=*parity) res=LIBSWD_ERROR_PARITY;
    }
-   if (retry==0) return LIBSWD_ERROR_MAXRETRY;
   }
   if (res<0) {
    libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR, "LIBSWD_E: libswd_dp_read(libswdctx=@%p, operation=%s, addr=0x%X, **data=0x%X/%s) failed: %s.\n", (void*)libswdctx, libswd_operation_string(operation), addr, **data, libswd_bin32_string(*data), libswd_error_string(res));
@@ -455,21 +912,8 @@ int libswd_dp_write(libswd_ctx_t *libswdctx, libswd_operation_t operation, char
   if (res>=0) {
    res=libswd_bus_write_data_ap(libswdctx, operation, data);
   } else if (res==LIBSWD_ERROR_ACK_WAIT) {
-   //We got ACK==WAIT, retry last transfer until success or failure.
-   int retry, ctrlstat, abort;
-   for (retry=LIBSWD_RETRY_COUNT_DEFAULT; retry>0; retry--){
-    abort=0xFFFFFFFF;
-    res=libswd_dap_errors_handle(libswdctx, LIBSWD_OPERATION_EXECUTE, &abort, &ctrlstat);
-    if (res<0) continue;
-    res=libswd_bus_write_request_raw(libswdctx, LIBSWD_OPERATION_ENQUEUE, &request);
-    if (res<0) continue;
-    res=libswd_bus_read_ack(libswdctx, LIBSWD_OPERATION_EXECUTE, &ack);
-    if (res<0) continue;
-    res=libswd_bus_write_data_ap(libswdctx, LIBSWD_OPERATION_EXECUTE, data);
-    if (res<0) continue;
-    break;
-   }
-   if (retry==0) return LIBSWD_ERROR_MAXRETRY;
+   //We got ACK==WAIT, reissue identical request according to WAIT policy.
+   res=libswd_dap_retry_wait(libswdctx, request, data, NULL, NULL);
   }
   if (res<0) {
    libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR, "LIBSWD_E: libswd_dp_write(libswdctx=@%p, operation=%s, addr=0x%X, *data=0x%X/%s) failed: %s.\n", (void*)libswdctx, libswd_operation_string(operation), addr, *data, libswd_bin32_string(data), libswd_error_string(res));
@@ -533,6 +977,7 @@ int libswd_ap_select(libswd_ctx_t *libswdctx, libswd_operation_t operation, int
  // If the correct AP is already selected no need to change it.
  // Verify against cached DP SELECT register value.
  // Unfortunately SELECT register is write only so we need to work on cached values...
+ if ( (libswdctx->log.dp.select&LIBSWD_DP_SELECT_APSEL)==((ap<<LIBSWD_DP_SELECT_APSEL_BITNUM)&LIBSWD_DP_SELECT_APSEL) ) return LIBSWD_OK;
  int retval;
  int new_select=libswdctx->log.dp.select;
  new_select&= ~LIBSWD_DP_SELECT_APSEL;
@@ -546,6 +991,166 @@ int libswd_ap_select(libswd_ctx_t *libswdctx, libswd_operation_t operation, int
 }
 
 
+/** Discover Access Ports by scanning IDR registers of APSEL 0..255.
+ * All IDR reads are pipelined into a single queue flush: for each APSEL
+ * the DP SELECT is written, IDR is read (posted) and its value is fetched
+ * with DP RDBUFF read. CFG and BASE of present APs are then read the same
+ * way in a second flush. If pipelined flush fails (ie. ACK WAIT) the scan
+ * falls back to one-by-one AP reads. Results are stored in
+ * libswdctx->aptable and DP SELECT is restored at the end.
+ * \param *libswdctx swd context to work on.
+ * \param *count will hold the number of APs found (can be NULL).
+ * \return number of APs found or LIBSWD_ERROR code on failure.
+ */
+int libswd_ap_scan(libswd_ctx_t *libswdctx, int *count){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG, "LIBSWD_D: libswd_ap_scan(*libswdctx=%p, *count=%p) entering function...\n", (void*)libswdctx, (void*)count);
+
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+
+ int res, i, n, select, oldselect, abort, *val, *idr[LIBSWD_AP_COUNT], *cfg[LIBSWD_AP_COUNT], *base[LIBSWD_AP_COUNT];
+ int idrval[LIBSWD_AP_COUNT], cfgval[LIBSWD_AP_COUNT], baseval[LIBSWD_AP_COUNT], present[LIBSWD_AP_COUNT];
+ char APnDP=1, DPnAP=0, RnW=1, *ack, *parity;
+ char idr_addr=LIBSWD_MEMAP_IDR_ADDR, cfg_addr=LIBSWD_MEMAP_CFG_ADDR, base_addr=LIBSWD_MEMAP_BASE_ADDR, rdbuff_addr=LIBSWD_DP_RDBUFF_ADDR;
+ char idr_request, cfg_request, base_request, rdbuff_request;
+
+ oldselect=libswdctx->log.dp.select;
+ res=libswd_bitgen8_request(libswdctx, &APnDP, &RnW, &idr_addr, &idr_request);
+ if (res<0) goto libswd_ap_scan_error;
+ res=libswd_bitgen8_request(libswdctx, &APnDP, &RnW, &cfg_addr, &cfg_request);
+ if (res<0) goto libswd_ap_scan_error;
+ res=libswd_bitgen8_request(libswdctx, &APnDP, &RnW, &base_addr, &base_request);
+ if (res<0) goto libswd_ap_scan_error;
+ res=libswd_bitgen8_request(libswdctx, &DPnAP, &RnW, &rdbuff_addr, &rdbuff_request);
+ if (res<0) goto libswd_ap_scan_error;
+
+ // Pipelined IDR read of all APs, posted IDR value is returned by RDBUFF.
+ for (i=0;i<LIBSWD_AP_COUNT;i++){
+  select=oldselect&~(LIBSWD_DP_SELECT_APSEL|LIBSWD_DP_SELECT_APBANKSEL);
+  select|=(i<<LIBSWD_DP_SELECT_APSEL_BITNUM)|(LIBSWD_MEMAP_IDR_APBANKSEL_VAL<<LIBSWD_DP_SELECT_APBANKSEL_BITNUM);
+  res=libswd_dp_write(libswdctx, LIBSWD_OPERATION_ENQUEUE, LIBSWD_DP_SELECT_ADDR, &select);
+  if (res<0) goto libswd_ap_scan_error;
+  res=libswd_bus_write_request_raw(libswdctx, LIBSWD_OPERATION_ENQUEUE, &idr_request);
+  if (res<0) goto libswd_ap_scan_error;
+  res=libswd_bus_read_ack(libswdctx, LIBSWD_OPERATION_ENQUEUE, &ack);
+  if (res<0) goto libswd_ap_scan_error;
+  res=libswd_bus_read_data_p(libswdctx, LIBSWD_OPERATION_ENQUEUE, &val, &parity);
+  if (res<0) goto libswd_ap_scan_error;
+  res=libswd_bus_write_request_raw(libswdctx, LIBSWD_OPERATION_ENQUEUE, &rdbuff_request);
+  if (res<0) goto libswd_ap_scan_error;
+  res=libswd_bus_read_ack(libswdctx, LIBSWD_OPERATION_ENQUEUE, &ack);
+  if (res<0) goto libswd_ap_scan_error;
+  res=libswd_bus_read_data_p(libswdctx, LIBSWD_OPERATION_ENQUEUE, &idr[i], &parity);
+  if (res<0) goto libswd_ap_scan_error;
+ }
+ res=libswd_cmdq_flush(libswdctx, &libswdctx->cmdq, LIBSWD_OPERATION_EXECUTE);
+ // SELECT was written behind the cache, invalidate its APSEL and APBANKSEL.
+ libswdctx->log.dp.select=oldselect^(LIBSWD_DP_SELECT_APSEL|LIBSWD_DP_SELECT_APBANKSEL);
+ if (res>=0){
+  for (i=0;i<LIBSWD_AP_COUNT;i++) idrval[i]=*idr[i];
+ } else {
+  libswd_log(libswdctx, LIBSWD_LOGLEVEL_WARNING, "LIBSWD_W: libswd_ap_scan(): pipelined IDR scan failed (%s), scanning one by one...\n", libswd_error_string(res));
+  abort=0xFFFFFFFE;
+  libswd_dap_errors_handle(libswdctx, LIBSWD_OPERATION_EXECUTE, &abort, NULL);
+  for (i=0;i<LIBSWD_AP_COUNT;i++){
+   select=oldselect&~(LIBSWD_DP_SELECT_APSEL|LIBSWD_DP_SELECT_APBANKSEL);
+   select|=(i<<LIBSWD_DP_SELECT_APSEL_BITNUM)|(LIBSWD_MEMAP_IDR_APBANKSEL_VAL<<LIBSWD_DP_SELECT_APBANKSEL_BITNUM);
+   res=libswd_dp_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_DP_SELECT_ADDR, &select);
+   if (res<0) goto libswd_ap_scan_error;
+   res=libswd_ap_read(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_IDR_ADDR, &val);
+   if (res<0) goto libswd_ap_scan_error;
+   idrval[i]=*val;
+  }
+ }
+
+ // Pipelined CFG and BASE read of present APs.
+ for (i=0, n=0;i<LIBSWD_AP_COUNT;i++){
+  cfgval[i]=baseval[i]=0;
+  if (!idrval[i]) continue;
+  present[n++]=i;
+  select=oldselect&~(LIBSWD_DP_SELECT_APSEL|LIBSWD_DP_SELECT_APBANKSEL);
+  select|=(i<<LIBSWD_DP_SELECT_APSEL_BITNUM)|(LIBSWD_MEMAP_CFG_APBANKSEL_VAL<<LIBSWD_DP_SELECT_APBANKSEL_BITNUM);
+  res=libswd_dp_write(libswdctx, LIBSWD_OPERATION_ENQUEUE, LIBSWD_DP_SELECT_ADDR, &select);
+  if (res<0) goto libswd_ap_scan_error;
+  res=libswd_bus_write_request_raw(libswdctx, LIBSWD_OPERATION_ENQUEUE, &cfg_request);
+  if (res<0) goto libswd_ap_scan_error;
+  res=libswd_bus_read_ack(libswdctx, LIBSWD_OPERATION_ENQUEUE, &ack);
+  if (res<0) goto libswd_ap_scan_error;
+  res=libswd_bus_read_data_p(libswdctx, LIBSWD_OPERATION_ENQUEUE, &val, &parity);
+  if (res<0) goto libswd_ap_scan_error;
+  res=libswd_bus_write_request_raw(libswdctx, LIBSWD_OPERATION_ENQUEUE, &base_request);
+  if (res<0) goto libswd_ap_scan_error;
+  res=libswd_bus_read_ack(libswdctx, LIBSWD_OPERATION_ENQUEUE, &ack);
+  if (res<0) goto libswd_ap_scan_error;
+  res=libswd_bus_read_data_p(libswdctx, LIBSWD_OPERATION_ENQUEUE, &cfg[i], &parity);
+  if (res<0) goto libswd_ap_scan_error;
+  res=libswd_bus_write_request_raw(libswdctx, LIBSWD_OPERATION_ENQUEUE, &rdbuff_request);
+  if (res<0) goto libswd_ap_scan_error;
+  res=libswd_bus_read_ack(libswdctx, LIBSWD_OPERATION_ENQUEUE, &ack);
+  if (res<0) goto libswd_ap_scan_error;
+  res=libswd_bus_read_data_p(libswdctx, LIBSWD_OPERATION_ENQUEUE, &base[i], &parity);
+  if (res<0) goto libswd_ap_scan_error;
+ }
+ if (n){
+  res=libswd_cmdq_flush(libswdctx, &libswdctx->cmdq, LIBSWD_OPERATION_EXECUTE);
+  libswdctx->log.dp.select=oldselect^(LIBSWD_DP_SELECT_APSEL|LIBSWD_DP_SELECT_APBANKSEL);
+  if (res>=0){
+   for (i=0;i<n;i++){
+    cfgval[present[i]]=*cfg[present[i]];
+    baseval[present[i]]=*base[present[i]];
+   }
+  } else {
+   libswd_log(libswdctx, LIBSWD_LOGLEVEL_WARNING, "LIBSWD_W: libswd_ap_scan(): pipelined CFG/BASE read failed (%s), reading one by one...\n", libswd_error_string(res));
+   abort=0xFFFFFFFE;
+   libswd_dap_errors_handle(libswdctx, LIBSWD_OPERATION_EXECUTE, &abort, NULL);
+   for (i=0;i<n;i++){
+    select=oldselect&~(LIBSWD_DP_SELECT_APSEL|LIBSWD_DP_SELECT_APBANKSEL);
+    select|=(present[i]<<LIBSWD_DP_SELECT_APSEL_BITNUM)|(LIBSWD_MEMAP_CFG_APBANKSEL_VAL<<LIBSWD_DP_SELECT_APBANKSEL_BITNUM);
+    res=libswd_dp_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_DP_SELECT_ADDR, &select);
+    if (res<0) goto libswd_ap_scan_error;
+    res=libswd_ap_read(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_CFG_ADDR, &val);
+    if (res<0) goto libswd_ap_scan_error;
+    cfgval[present[i]]=*val;
+    res=libswd_ap_read(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_BASE_ADDR, &val);
+    if (res<0) goto libswd_ap_scan_error;
+    baseval[present[i]]=*val;
+   }
+  }
+ }
+
+ // Restore DP SELECT, this also brings its cached value back in sync.
+ res=libswd_dp_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_DP_SELECT_ADDR, &oldselect);
+ if (res<0) goto libswd_ap_scan_error;
+
+ // Update the AP table, keep cached MEM-AP registers of each AP.
+ for (i=0;i<LIBSWD_AP_COUNT;i++){
+  libswdctx->aptable.ap[i].present=idrval[i]?1:0;
+  libswdctx->aptable.ap[i].idr=idrval[i];
+  libswdctx->aptable.ap[i].cfg=cfgval[i];
+  libswdctx->aptable.ap[i].base=baseval[i];
+  libswdctx->aptable.ap[i].type=(idrval[i]&LIBSWD_AP_IDR_TYPE)>>LIBSWD_AP_IDR_TYPE_BITNUM;
+  libswdctx->aptable.ap[i].apclass=(idrval[i]&LIBSWD_AP_IDR_CLASS)>>LIBSWD_AP_IDR_CLASS_BITNUM;
+  libswdctx->aptable.ap[i].memap.idr=idrval[i];
+  libswdctx->aptable.ap[i].memap.cfg=cfgval[i];
+  libswdctx->aptable.ap[i].memap.base=baseval[i];
+  if (idrval[i]) libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO, "LIBSWD_I: libswd_ap_scan(): AP[%d] IDR=0x%08X CLASS=0x%X TYPE=0x%X CFG=0x%08X BASE=0x%08X\n", i, idrval[i], libswdctx->aptable.ap[i].apclass, libswdctx->aptable.ap[i].type, cfgval[i], baseval[i]);
+ }
+ // Current AP cache lives in log.memap.
+ i=libswdctx->aptable.current;
+ libswdctx->log.memap.idr=idrval[i];
+ libswdctx->log.memap.cfg=cfgval[i];
+ libswdctx->log.memap.base=baseval[i];
+ libswdctx->aptable.count=n;
+ libswdctx->aptable.scanned=1;
+ if (count) *count=n;
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG, "LIBSWD_D: libswd_ap_scan(*libswdctx=%p) execution OK, %d APs found.\n", (void*)libswdctx, n);
+ return n;
+
+libswd_ap_scan_error:
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR, "LIBSWD_E: libswd_ap_scan(libswdctx=@%p) failed: %s.\n", (void*)libswdctx, libswd_error_string(res));
+ return res;
+}
+
+
 /** Macro function: Generic read of the AP register.
  * Address field should contain AP BANK on bits [4..7].
  * \param *libswdctx swd context to work on.
@@ -562,7 +1167,7 @@ int libswd_ap_read(libswd_ctx_t *libswdctx, libswd_operation_t operation, char a
  if (operation!=LIBSWD_OPERATION_ENQUEUE && operation!=LIBSWD_OPERATION_EXECUTE)
   return LIBSWD_ERROR_BADOPCODE;
 
- int res, cmdcnt=0, retry, ctrlstat, abort;
+ int res, cmdcnt=0, ctrlstat, abort;
  char APnDP, RnW, *ack, *parity, request;
 
  res=libswd_ap_bank_select(libswdctx, LIBSWD_OPERATION_ENQUEUE, addr);
@@ -592,35 +1197,377 @@ int libswd_ap_read(libswd_ctx_t *libswdctx, libswd_operation_t operation, char a
    res=libswd_bus_read_data_p(libswdctx, operation, data, &parity);
    if (res<0) return res;
   } else if (res==LIBSWD_ERROR_ACK_WAIT) {
-   //We got ACK==WAIT, retry last transfer until success or failure.
-   for (retry=LIBSWD_RETRY_COUNT_DEFAULT; retry>0; retry--){
-    abort=0xFFFFFFFE;
-    res=libswd_dap_errors_handle(libswdctx, LIBSWD_OPERATION_EXECUTE, &abort, NULL);
-    if (res<0) continue;
-    res=libswd_bus_write_request_raw(libswdctx, LIBSWD_OPERATION_ENQUEUE, &request);
-    if (res<0) continue;
-    res=libswd_bus_read_ack(libswdctx, LIBSWD_OPERATION_EXECUTE, &ack);
-    if (res<0) continue;
-    res=libswd_bus_read_data_p(libswdctx, LIBSWD_OPERATION_EXECUTE, data, &parity);
-    if (res<0) continue;
-   break;
-   }
-   if (retry==0) return LIBSWD_ERROR_MAXRETRY;
+   //We got ACK==WAIT, reissue identical request according to WAIT policy.
+   res=libswd_dap_retry_wait(libswdctx, request, NULL, data, &parity);
+   if (res<0) return res;
   }
   res=libswd_dp_read(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_DP_RDBUFF_ADDR, data);
   if (res<0) {
    libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR, "LIBSWD_E: libswd_ap_read(libswdctx=@%p, operation=%s, addr=0x%X, **data=0x%X/%s) failed: %s.\n", (void*)libswdctx, libswd_operation_string(operation), addr, **data, libswd_bin32_string(*data), libswd_error_string(res));
    return res;
   }
-  // Clear all possible error flags that may remain, but don't abort transaction.
-  abort=0xFFFFFFFE;
-  res=libswd_dap_errors_handle(libswdctx, LIBSWD_OPERATION_EXECUTE, &abort, &ctrlstat);
+  // Posted read fault is only visible in CTRL/STAT, check it and clear
+  // error flags that may remain, but don't abort transaction.
+  res=libswd_dap_errors_handle(libswdctx, LIBSWD_OPERATION_EXECUTE, NULL, &ctrlstat);
   if (res<0) return res;
+  if (libswdctx->log.dp.ctrlstat&(LIBSWD_DP_CTRLSTAT_STICKYERR|LIBSWD_DP_CTRLSTAT_STICKYCMP|LIBSWD_DP_CTRLSTAT_STICKYORUN|LIBSWD_DP_CTRLSTAT_WDATAERR)){
+   abort=0xFFFFFFFE;
+   res=libswd_dap_errors_handle(libswdctx, LIBSWD_OPERATION_EXECUTE, &abort, NULL);
+   if (res<0) return res;
+   if (libswdctx->log.dp.ctrlstat&LIBSWD_DP_CTRLSTAT_STICKYERR){
+    libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR, "LIBSWD_E: libswd_ap_read(libswdctx=@%p, operation=%s, addr=0x%X) failed: STICKYERR set.\n", (void*)libswdctx, libswd_operation_string(operation), addr);
+    return LIBSWD_ERROR_ACK_FAULT;
+   }
+  }
   libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG, "LIBSWD_D: libswd_ap_read(libswdctx=@%p, command=%s, addr=0x%X, **data=0x%X/%s) execution OK.\n", (void*)libswdctx, libswd_operation_string(operation), addr, **data, libswd_bin32_string(*data));
   return cmdcnt;
  } else return LIBSWD_ERROR_BADOPCODE;
 }
 
+/** Allocate new result slot for the enqueued read.
+ * \param *libswdctx swd context to work on.
+ * \return slot index (result handle) or LIBSWD_ERROR code on failure.
+ */
+int libswd_result_alloc(libswd_ctx_t *libswdctx){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ libswd_result_t *slot;
+ int size;
+ if (libswdctx->results.count==libswdctx->results.size){
+  size=libswdctx->results.size?libswdctx->results.size*2:64;
+  slot=(libswd_result_t*)realloc(libswdctx->results.slot, size*sizeof(libswd_result_t));
+  if (slot==NULL) return LIBSWD_ERROR_OUTOFMEM;
+  libswdctx->results.slot=slot;
+  libswdctx->results.size=size;
+ }
+ memset(&libswdctx->results.slot[libswdctx->results.count], 0, sizeof(libswd_result_t));
+ return libswdctx->results.count++;
+}
+
+/** Enqueue read of the DP register and return result handle.
+ * Unlike libswd_dp_read() in LIBSWD_OPERATION_ENQUEUE mode, the result
+ * is not overwritten by next enqueued reads, so any number of reads can be
+ * enqueued, executed with one libswd_cmdq_flush(), and then collected with
+ * libswd_result_get().
+ * \param *libswdctx swd context to work on.
+ * \param addr is the address of the DP register to read.
+ * \return result handle or LIBSWD_ERROR code on failure.
+ */
+int libswd_dp_read_result(libswd_ctx_t *libswdctx, char addr){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG, "LIBSWD_D: libswd_dp_read_result(*libswdctx=%p, addr=0x%X) entering function...\n", (void*)libswdctx, (unsigned char)addr);
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ int res, handle, *data;
+ char APnDP, RnW, request, *ack, *parity;
+ libswd_cmd_t *cmd;
+
+ APnDP=0;
+ RnW=1;
+ res=libswd_bitgen8_request(libswdctx, &APnDP, &RnW, &addr, &request);
+ if (res<0) return res;
+ handle=libswd_result_alloc(libswdctx);
+ if (handle<0) return handle;
+
+ res=libswd_bus_write_request_raw(libswdctx, LIBSWD_OPERATION_ENQUEUE, &request);
+ if (res<1) return res;
+ res=libswd_bus_read_ack(libswdctx, LIBSWD_OPERATION_ENQUEUE, &ack);
+ if (res<1) return res;
+ libswd_cmdq_find_tail(libswdctx->cmdq)->result=handle+1;
+ res=libswd_bus_read_data_p(libswdctx, LIBSWD_OPERATION_ENQUEUE, &data, &parity);
+ if (res<1) return res;
+ cmd=libswd_cmdq_find_tail(libswdctx->cmdq);
+ cmd->result=handle+1;
+ cmd->prev->result=handle+1;
+ return handle;
+}
+
+/** Enqueue read of the AP register and return result handle.
+ * AP reads are posted, so result of each AP read is taken from the
+ * trailing RDBUFF read. When next AP read is enqueued right after, that
+ * trailing RDBUFF read is replaced with the new AP read request, which
+ * returns previous result in its data phase, so N reads of the same AP
+ * bank take N+1 transactions instead of 2N.
+ * Address field should contain AP BANK on bits [4..7].
+ * \param *libswdctx swd context to work on.
+ * \param addr is the address of the AP register to read plus AP BANK on bits[4..7].
+ * \return result handle or LIBSWD_ERROR code on failure.
+ */
+int libswd_ap_read_result(libswd_ctx_t *libswdctx, char addr){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG, "LIBSWD_D: libswd_ap_read_result(*libswdctx=%p, addr=0x%X) entering function...\n", (void*)libswdctx, (unsigned char)addr);
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ int res, handle, *data;
+ char APnDP, RnW, request, rdbuffaddr, *ack, *parity;
+ libswd_cmd_t *cmd;
+
+ res=libswd_ap_bank_select(libswdctx, LIBSWD_OPERATION_ENQUEUE, addr);
+ if (res<0) return res;
+ APnDP=1;
+ RnW=1;
+ res=libswd_bitgen8_request(libswdctx, &APnDP, &RnW, &addr, &request);
+ if (res<0) return res;
+ handle=libswd_result_alloc(libswdctx);
+ if (handle<0) return handle;
+
+ // Look for the trailing RDBUFF read of the previous AP read at the queue
+ // tail. Walk the queue instead of dereferencing saved pointers, as the
+ // tail may have been freed by the error handling in the meantime.
+ cmd=libswd_cmdq_find_tail(libswdctx->cmdq);
+ if (cmd!=libswdctx->results.rdbuffparity) cmd=NULL;
+ while (cmd && cmd->cmdtype!=LIBSWD_CMDTYPE_MOSI_REQUEST) cmd=cmd->prev;
+ if (cmd && cmd==libswdctx->results.rdbuff && !cmd->done){
+  // Replace RDBUFF read with AP read, its data phase still returns previous result.
+  cmd->request=request;
+  while (cmd->cmdtype!=LIBSWD_CMDTYPE_MISO_ACK) cmd=cmd->next;
+  cmd->result=handle+1;
+ } else {
+  res=libswd_bus_write_request_raw(libswdctx, LIBSWD_OPERATION_ENQUEUE, &request);
+  if (res<1) return res;
+  res=libswd_bus_read_ack(libswdctx, LIBSWD_OPERATION_ENQUEUE, &ack);
+  if (res<1) return res;
+  libswd_cmdq_find_tail(libswdctx->cmdq)->result=handle+1;
+  res=libswd_bus_read_data_p(libswdctx, LIBSWD_OPERATION_ENQUEUE, &data, &parity);
+  if (res<1) return res;
+ }
+
+ // Trailing RDBUFF read returns the result.
+ APnDP=0;
+ rdbuffaddr=LIBSWD_DP_RDBUFF_ADDR;
+ res=libswd_bitgen8_request(libswdctx, &APnDP, &RnW, &rdbuffaddr, &request);
+ if (res<0) return res;
+ res=libswd_bus_write_request_raw(libswdctx, LIBSWD_OPERATION_ENQUEUE, &request);
+ if (res<1) return res;
+ libswdctx->results.rdbuff=libswd_cmdq_find_tail(libswdctx->cmdq);
+ res=libswd_bus_read_ack(libswdctx, LIBSWD_OPERATION_ENQUEUE, &ack);
+ if (res<1) return res;
+ res=libswd_bus_read_data_p(libswdctx, LIBSWD_OPERATION_ENQUEUE, &data, &parity);
+ if (res<1) return res;
+ cmd=libswd_cmdq_find_tail(libswdctx->cmdq);
+ cmd->result=handle+1;
+ cmd->prev->result=handle+1;
+ libswdctx->results.rdbuffparity=cmd;
+ return handle;
+}
+
+/** Fill in the result slot bound to the transmitted command.
+ * Called by libswd_drv_transmit() for commands with non-zero result field.
+ * Slot of the write holds the written value once data phase is done.
+ * \param *libswdctx swd context to work on.
+ * \param *cmd transmitted command.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_result_update(libswd_ctx_t *libswdctx, libswd_cmd_t *cmd){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (cmd==NULL) return LIBSWD_ERROR_NULLPOINTER;
+ if (cmd->result<1 || cmd->result>libswdctx->results.count) return LIBSWD_ERROR_PARAM;
+ libswd_result_t *slot=&libswdctx->results.slot[cmd->result-1];
+ libswd_cmd_t *ack;
+ // Data phase after ACK!=OK is not driven by target, leave slot untouched.
+ if (cmd->cmdtype!=LIBSWD_CMDTYPE_MISO_ACK){
+  for (ack=cmd->prev;ack && ack->cmdtype!=LIBSWD_CMDTYPE_MISO_ACK;ack=ack->prev);
+  if (ack==NULL || ack->ack!=LIBSWD_ACK_OK_VAL) return LIBSWD_OK;
+ }
+ switch (cmd->cmdtype){
+  case LIBSWD_CMDTYPE_MISO_ACK:
+   slot->ack=cmd->ack;
+   break;
+  case LIBSWD_CMDTYPE_MISO_DATA:
+  case LIBSWD_CMDTYPE_MOSI_DATA:
+   slot->data=cmd->data32;
+   break;
+  case LIBSWD_CMDTYPE_MISO_PARITY:
+  case LIBSWD_CMDTYPE_MOSI_PARITY:
+   slot->parity=cmd->parity;
+   slot->done=1;
+   break;
+  default:
+   return LIBSWD_ERROR_BADCMDTYPE;
+ }
+ return LIBSWD_OK;
+}
+
+/** Collect the result of the enqueued read after the queue was flushed.
+ * ACK and data parity are verified. Reads enqueued after failed transaction
+ * are dropped by the error handling, so they will return
+ * LIBSWD_ERROR_ACKNOTDONE and can be enqueued again.
+ * \param *libswdctx swd context to work on.
+ * \param handle result handle returned by libswd_dp/ap_read_result().
+ * \param *data pointer to store the result.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_result_get(libswd_ctx_t *libswdctx, int handle, int *data){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (data==NULL) return LIBSWD_ERROR_NULLPOINTER;
+ if (handle<0 || handle>=libswdctx->results.count) return LIBSWD_ERROR_PARAM;
+ libswd_result_t *slot=&libswdctx->results.slot[handle];
+ char parity;
+ switch (slot->ack){
+  case 0: return LIBSWD_ERROR_ACKNOTDONE;
+  case LIBSWD_ACK_OK_VAL: break;
+  case LIBSWD_ACK_WAIT_VAL: return LIBSWD_ERROR_ACK_WAIT;
+  case LIBSWD_ACK_FAULT_VAL: return LIBSWD_ERROR_ACK_FAULT;
+  default: return LIBSWD_ERROR_ACKUNKNOWN;
+ }
+ if (!slot->done) return LIBSWD_ERROR_ACKNOTDONE;
+ if (libswd_bin32_parity_even(&slot->data, &parity)<0) return LIBSWD_ERROR_PARITY;
+ if (parity!=slot->parity) return LIBSWD_ERROR_PARITY;
+ *data=slot->data;
+ return LIBSWD_OK;
+}
+
+/** Release all result slots, handles become invalid.
+ * Call it only after the queue with enqueued reads was flushed.
+ * \param *libswdctx swd context to work on.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_result_reset(libswd_ctx_t *libswdctx){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ libswdctx->results.count=0;
+ libswdctx->results.rdbuff=NULL;
+ libswdctx->results.rdbuffparity=NULL;
+ return LIBSWD_OK;
+}
+
+/** Execute list of DP/AP transfers planned as a whole, see libswd_xfer_t.
+ * Entries are enqueued and executed with one queue flush: redundant SELECT
+ * writes are dropped, posted AP reads are pipelined with single trailing
+ * RDBUFF read, and sticky errors are checked once with CTRL/STAT read at
+ * the end. Value match reads are polled up to config.matchretry times, so
+ * the list is flushed in segments separated by the match reads.
+ * Written values of SELECT are taken as the new cached DP SELECT value.
+ * \param *libswdctx swd context to work on.
+ * \param *list transfers to execute.
+ * \param n number of entries on the list.
+ * \param *failed if not NULL will hold the first failing entry index or -1.
+ * \return number of entries executed or LIBSWD_ERROR code on failure.
+ */
+int libswd_transfer(libswd_ctx_t *libswdctx, libswd_xfer_t *list, int n, int *failed){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG, "LIBSWD_D: libswd_transfer(*libswdctx=%p, *list=%p, n=%d) entering function...\n", (void*)libswdctx, (void*)list, n);
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (list==NULL) return LIBSWD_ERROR_NULLPOINTER;
+ if (n<0) return LIBSWD_ERROR_PARAM;
+ int i, j, res, flushres, first, seg, lastap, sticky, retry, value, abort;
+ libswd_xfer_t *xfer;
+ libswd_cmd_t *cmd;
+
+ if (failed) *failed=-1;
+ libswd_stats_enter(libswdctx, LIBSWD_STATS_CLASS_DAP);
+ first=libswdctx->results.count;
+ seg=0;
+ for (i=0;i<=n;i++){
+  xfer=(i<n)?&list[i]:NULL;
+  // Enqueue everything up to the match read or the list end.
+  if (xfer && !(xfer->RnW && xfer->matchmask)){
+   if (xfer->RnW){
+    if (xfer->APnDP) xfer->handle=libswd_ap_read_result(libswdctx, xfer->addr);
+    else xfer->handle=libswd_dp_read_result(libswdctx, xfer->addr);
+    res=xfer->handle;
+    if (res<0) goto libswd_transfer_error;
+    continue;
+   }
+   value=xfer->data?*xfer->data:xfer->value;
+   xfer->handle=-1;
+   if (!xfer->APnDP && xfer->addr==LIBSWD_DP_SELECT_ADDR && value==libswdctx->log.dp.select) continue;
+   if (xfer->APnDP) res=libswd_ap_write(libswdctx, LIBSWD_OPERATION_ENQUEUE, xfer->addr, &value);
+   else res=libswd_dp_write(libswdctx, LIBSWD_OPERATION_ENQUEUE, xfer->addr, &value);
+   if (res<0) goto libswd_transfer_error;
+   if (!xfer->APnDP && xfer->addr==LIBSWD_DP_SELECT_ADDR) libswdctx->log.dp.select=value;
+   xfer->handle=libswd_result_alloc(libswdctx);
+   res=xfer->handle;
+   if (res<0) goto libswd_transfer_error;
+   cmd=libswd_cmdq_find_tail(libswdctx->cmdq);
+   cmd->result=xfer->handle+1;
+   cmd->prev->result=xfer->handle+1;
+   while (cmd->cmdtype!=LIBSWD_CMDTYPE_MISO_ACK) cmd=cmd->prev;
+   cmd->result=xfer->handle+1;
+   continue;
+  }
+
+  // Flush enqueued segment, verify sticky errors if any AP was accessed.
+  if (i>seg){
+   lastap=-1;
+   for (j=seg;j<i;j++) if (list[j].APnDP) lastap=j;
+   sticky=-1;
+   if (lastap>=0){
+    sticky=libswd_dp_read_result(libswdctx, LIBSWD_DP_CTRLSTAT_ADDR);
+    res=sticky;
+    if (res<0) goto libswd_transfer_error;
+   }
+   flushres=libswd_cmdq_flush(libswdctx, &libswdctx->cmdq, LIBSWD_OPERATION_EXECUTE);
+   libswdctx->results.rdbuff=NULL;
+   libswdctx->results.rdbuffparity=NULL;
+   for (j=seg;j<i;j++){
+    if (list[j].handle<0) continue;
+    res=libswd_result_get(libswdctx, list[j].handle, &value);
+    if (res<0){
+     // Entry was dropped by failed flush or its posted result never came.
+     if (res==LIBSWD_ERROR_ACKNOTDONE && flushres<0) res=flushres;
+     if (failed) *failed=j;
+     goto libswd_transfer_error;
+    }
+    if (list[j].RnW){
+     list[j].value=value;
+     if (list[j].data) *list[j].data=value;
+    }
+   }
+   res=flushres;
+   if (res>=0 && sticky>=0){
+    res=libswd_result_get(libswdctx, sticky, &value);
+    if (res>=0){
+     libswdctx->log.dp.ctrlstat=value;
+     if (value&(LIBSWD_DP_CTRLSTAT_STICKYERR|LIBSWD_DP_CTRLSTAT_STICKYORUN|LIBSWD_DP_CTRLSTAT_WDATAERR))
+      res=LIBSWD_ERROR_ACK_FAULT;
+    }
+   }
+   if (res<0){
+    // Posted AP access fault cannot be located more precisely.
+    if (failed) *failed=lastap>=0?lastap:i-1;
+    goto libswd_transfer_error;
+   }
+   seg=i;
+  }
+  if (xfer==NULL) break;
+
+  // Value match read, poll the register until it matches.
+  for (retry=0;;retry++){
+   if (xfer->APnDP) xfer->handle=libswd_ap_read_result(libswdctx, xfer->addr);
+   else xfer->handle=libswd_dp_read_result(libswdctx, xfer->addr);
+   res=xfer->handle;
+   if (res>=0) res=libswd_cmdq_flush(libswdctx, &libswdctx->cmdq, LIBSWD_OPERATION_EXECUTE);
+   libswdctx->results.rdbuff=NULL;
+   libswdctx->results.rdbuffparity=NULL;
+   if (res>=0) res=libswd_result_get(libswdctx, xfer->handle, &xfer->value);
+   if (xfer->handle>=0) libswdctx->results.count=xfer->handle;
+   xfer->handle=-1;
+   if (res<0 || (xfer->value&xfer->matchmask)==(xfer->matchvalue&xfer->matchmask)) break;
+   if (retry>=libswdctx->config.matchretry){
+    res=LIBSWD_ERROR_MISMATCH;
+    break;
+   }
+  }
+  if (res<0){
+   if (failed) *failed=i;
+   goto libswd_transfer_error;
+  }
+  if (xfer->data) *xfer->data=xfer->value;
+  seg=i+1;
+ }
+
+ libswdctx->results.count=first;
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG, "LIBSWD_D: libswd_transfer(*libswdctx=%p, *list=%p, n=%d) execution OK.\n", (void*)libswdctx, (void*)list, n);
+ libswd_stats_leave(libswdctx, LIBSWD_STATS_CLASS_DAP);
+ return n;
+
+libswd_transfer_error:
+ libswdctx->results.count=first;
+ libswdctx->results.rdbuff=NULL;
+ libswdctx->results.rdbuffparity=NULL;
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR, "LIBSWD_E: libswd_transfer(*libswdctx=%p, *list=%p, n=%d) failed at entry %d: %s.\n", (void*)libswdctx, (void*)list, n, failed?*failed:-1, libswd_error_string(res));
+ // Clear sticky errors and bring cached SELECT back in sync with target.
+ abort=0xFFFFFFFE;
+ libswd_dap_errors_handle(libswdctx, LIBSWD_OPERATION_EXECUTE, &abort, NULL);
+ libswd_dp_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_DP_SELECT_ADDR, &libswdctx->log.dp.select);
+ libswd_stats_leave(libswdctx, LIBSWD_STATS_CLASS_DAP);
+ return res;
+}
+
 /** Macro function: Generic write of the AP register.
  * Address field should contain AP BANK on bits [4..7].
  * \param *libswdctx swd context to work on.
@@ -636,7 +1583,7 @@ int libswd_ap_write(libswd_ctx_t *libswdctx, libswd_operation_t operation, char
  if (operation!=LIBSWD_OPERATION_ENQUEUE && operation!=LIBSWD_OPERATION_EXECUTE)
   return LIBSWD_ERROR_BADOPCODE;
 
- int res, cmdcnt=0, retry, ctrlstat, abort;
+ int res, cmdcnt=0, ctrlstat, abort;
  char APnDP, RnW, *ack, request;
 
  res=libswd_ap_bank_select(libswdctx, LIBSWD_OPERATION_ENQUEUE, addr);
@@ -669,25 +1616,13 @@ int libswd_ap_write(libswd_ctx_t *libswdctx, libswd_operation_t operation, char
    if (res<0) return res;
    cmdcnt+=res;
   } else if (res==LIBSWD_ERROR_ACK_WAIT) {
-   //We got ACK==WAIT, retry last transfer until success or failure.
-   for (retry=LIBSWD_RETRY_COUNT_DEFAULT; retry>0; retry--){
-    abort=0xFFFFFFFE;
-    res=libswd_dap_errors_handle(libswdctx, LIBSWD_OPERATION_EXECUTE, &abort, NULL);
-    if (res<0) continue;
-    res=libswd_bus_write_request_raw(libswdctx, LIBSWD_OPERATION_ENQUEUE, &request);
-    if (res<0) continue;
-    res=libswd_bus_read_ack(libswdctx, LIBSWD_OPERATION_EXECUTE, &ack);
-    if (res<0) continue;
-    res=libswd_bus_write_data_ap(libswdctx, LIBSWD_OPERATION_EXECUTE, data);
-    if (res<0) continue;
-    break;
-   }
-   if (retry==0) return LIBSWD_ERROR_MAXRETRY;
+   //We got ACK==WAIT, reissue identical request according to WAIT policy.
+   res=libswd_dap_retry_wait(libswdctx, request, data, NULL, NULL);
   }
   if (res<0) {
    libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR, "LIBSWD_E: libswd_ap_write(libswdctx=@%p, operation=%s, addr=0x%X, *data=0x%X/%s) failed: %s.\n", (void*)libswdctx, libswd_operation_string(operation), addr, *data, libswd_bin32_string(data), libswd_error_string(res));
    abort=0xFFFFFFFE;
-   res=libswd_dap_errors_handle(libswdctx, LIBSWD_OPERATION_EXECUTE, &abort, &ctrlstat);
+   libswd_dap_errors_handle(libswdctx, LIBSWD_OPERATION_EXECUTE, &abort, &ctrlstat);
    return res;
   }
   libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG, "LIBSWD_D: libswd_ap_write(libswdctx=@%p, operation=%s, addr=0x%X, *data=0x%X/%s) execution OK.\n", (void*)libswdctx, libswd_operation_string(operation), addr, *data, libswd_bin32_string(data));
@@ -698,4 +1633,203 @@ int libswd_ap_write(libswd_ctx_t *libswdctx, libswd_operation_t operation, char
 
 
 
+/** Transfer a run of AP accesses in overrun detection streaming mode.
+ * All requests are enqueued back-to-back followed by a single DP RDBUFF read
+ * and flushed at once without verifying each ACK, as allowed by CTRL/STAT
+ * ORUNDETECT (set by libswd_dap_init()). First ACK!=OK is remembered by
+ * libswd_drv_transmit(), STICKYORUN is checked with one CTRL/STAT read at the
+ * end, and only the overrun part of the run is replayed. AP reads are posted,
+ * so the result of access N arrives in the data phase of access N+1 (or the
+ * trailing RDBUFF). Sticky transfer errors are not replayed but reported,
+ * number of accesses acknowledged before the failure is in stream.done.
+ * When ORUNDETECT is not set, libswd_ap_read()/libswd_ap_write() are used.
+ * Writes take word i from data[i*stride], so stride 0 streams one constant
+ * value without building an array. Reads require stride 1.
+ * \param *libswdctx swd context to work on.
+ * \param RnW is 1 for AP read, 0 for AP write.
+ * \param addr is the address of the AP register plus AP BANK on bits [4..7].
+ * \param *data array of count words to write, or to store read results.
+ * \param count number of AP accesses to perform.
+ * \param stride is the data array step between accesses [words].
+ * \return number of words transferred or LIBSWD_ERROR code on failure.
+ */
+int libswd_ap_stream_stride(libswd_ctx_t *libswdctx, char RnW, char addr, int *data, int count, int stride){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG, "LIBSWD_D: libswd_ap_stream_stride(*libswdctx=%p, RnW=%d, addr=0x%X, *data=%p, count=%d, stride=%d) entering function...\n", (void*)libswdctx, RnW, (unsigned char)addr, (void*)data, count, stride);
+
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (data==NULL) return LIBSWD_ERROR_NULLPOINTER;
+ if (RnW!=0 && RnW!=1) return LIBSWD_ERROR_RnW;
+ if (count<1 || stride<0 || (RnW && stride!=1)) return LIBSWD_ERROR_PARAM;
+
+ int res, i, n, idx, valid, first=0, retry=LIBSWD_RETRY_COUNT_DEFAULT;
+ int abort, *ctrlstat, *rdbuff, **rdata=NULL;
+ char APnDP=1, DPnAP=0, DPRnW=1, rdbuff_addr=LIBSWD_DP_RDBUFF_ADDR;
+ char request, rdbuff_request, *ack, *parity;
+
+ libswdctx->stream.done=0;
+ libswd_stats_enter(libswdctx, LIBSWD_STATS_CLASS_DAP);
+ // Without overrun detection every ACK must be verified on the fly.
+ if (!(libswdctx->log.dp.ctrlstat&LIBSWD_DP_CTRLSTAT_ORUNDETECT)){
+  for (i=0;i<count;i++){
+   if (RnW){
+    res=libswd_ap_read(libswdctx, LIBSWD_OPERATION_EXECUTE, addr, &rdbuff);
+    if (res<0) goto libswd_ap_stream_stride_error;
+    data[i]=*rdbuff;
+   } else {
+    res=libswd_ap_write(libswdctx, LIBSWD_OPERATION_EXECUTE, addr, &data[i*stride]);
+    if (res<0) goto libswd_ap_stream_stride_error;
+   }
+   libswdctx->stream.done=i+1;
+  }
+  libswd_stats_leave(libswdctx, LIBSWD_STATS_CLASS_DAP);
+  return count;
+ }
+
+ // SELECT write is a DP access, so setup the bank before the stream.
+ res=libswd_ap_bank_select(libswdctx, LIBSWD_OPERATION_EXECUTE, addr);
+ if (res<0) goto libswd_ap_stream_stride_error;
+ res=libswd_bitgen8_request(libswdctx, &APnDP, &RnW, &addr, &request);
+ if (res<0) goto libswd_ap_stream_stride_error;
+ res=libswd_bitgen8_request(libswdctx, &DPnAP, &DPRnW, &rdbuff_addr, &rdbuff_request);
+ if (res<0) goto libswd_ap_stream_stride_error;
+ // Data pointers for every data phase in the stream including RDBUFF.
+ if (RnW){
+  rdata=(int**)calloc(count+1, sizeof(int*));
+  if (rdata==NULL){
+   res=LIBSWD_ERROR_OUTOFMEM;
+   goto libswd_ap_stream_stride_error;
+  }
+ }
+
+ for (;;){
+  n=count-first;
+  libswdctx->stream.count=0;
+  libswdctx->stream.failed=-1;
+  libswdctx->stream.ack=0;
+  libswdctx->stream.active=1;
+  for (i=0;i<n;i++){
+   res=libswd_bus_write_request_raw(libswdctx, LIBSWD_OPERATION_ENQUEUE, &request);
+   if (res<0) goto libswd_ap_stream_stride_error;
+   res=libswd_bus_read_ack(libswdctx, LIBSWD_OPERATION_ENQUEUE, &ack);
+   if (res<0) goto libswd_ap_stream_stride_error;
+   if (RnW){
+    res=libswd_bus_read_data_p(libswdctx, LIBSWD_OPERATION_ENQUEUE, &rdata[i], &parity);
+   } else res=libswd_bus_write_data_ap(libswdctx, LIBSWD_OPERATION_ENQUEUE, &data[(first+i)*stride]);
+   if (res<0) goto libswd_ap_stream_stride_error;
+  }
+  // Trailing RDBUFF returns last posted read and completes last write.
+  res=libswd_bus_write_request_raw(libswdctx, LIBSWD_OPERATION_ENQUEUE, &rdbuff_request);
+  if (res<0) goto libswd_ap_stream_stride_error;
+  res=libswd_bus_read_ack(libswdctx, LIBSWD_OPERATION_ENQUEUE, &ack);
+  if (res<0) goto libswd_ap_stream_stride_error;
+  res=libswd_bus_read_data_p(libswdctx, LIBSWD_OPERATION_ENQUEUE, RnW?&rdata[n]:&rdbuff, &parity);
+  if (res<0) goto libswd_ap_stream_stride_error;
+  res=libswd_cmdq_flush(libswdctx, &libswdctx->cmdq, LIBSWD_OPERATION_EXECUTE);
+  libswdctx->stream.active=0;
+  if (res<0) goto libswd_ap_stream_stride_error;
+
+  // Data phase of stream transaction i holds result of AP read first+i-1.
+  valid=(libswdctx->stream.failed<0)?n+1:libswdctx->stream.failed;
+  libswdctx->stream.done=first+((valid<n)?valid:n);
+  if (RnW){
+   for (i=0;i<valid;i++){
+    idx=first+i-1;
+    if (idx>=0) data[idx]=*rdata[i];
+   }
+  }
+
+  // Check sticky flags once for the whole stream.
+  res=libswd_dp_read(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_DP_CTRLSTAT_ADDR, &ctrlstat);
+  if (res<0) goto libswd_ap_stream_stride_error;
+  if (*ctrlstat&(LIBSWD_DP_CTRLSTAT_STICKYERR|LIBSWD_DP_CTRLSTAT_WDATAERR)){
+   // This is a real transfer error, replay would not help.
+   abort=LIBSWD_DP_ABORT_STKERRCLR|LIBSWD_DP_ABORT_WDERRCLR|LIBSWD_DP_ABORT_ORUNERRCLR;
+   libswd_dp_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_DP_ABORT_ADDR, &abort);
+   res=LIBSWD_ERROR_ACK_FAULT;
+   goto libswd_ap_stream_stride_error;
+  }
+  if (libswdctx->stream.failed>=0
+      && libswdctx->stream.ack!=LIBSWD_ACK_WAIT_VAL
+      && libswdctx->stream.ack!=LIBSWD_ACK_FAULT_VAL){
+   res=LIBSWD_ERROR_ACKUNKNOWN;
+   goto libswd_ap_stream_stride_error;
+  }
+  if (*ctrlstat&LIBSWD_DP_CTRLSTAT_STICKYORUN){
+   abort=LIBSWD_DP_ABORT_ORUNERRCLR;
+   res=libswd_dp_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_DP_ABORT_ADDR, &abort);
+   if (res<0) goto libswd_ap_stream_stride_error;
+  }
+  if (libswdctx->stream.failed<0) break;
+
+  // Overrun: accesses before the failed one were accepted, replay the rest.
+  libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG, "LIBSWD_D: libswd_ap_stream_stride(): overrun at access %d/%d (ACK=%d), replaying...\n", first+libswdctx->stream.failed, count, libswdctx->stream.ack);
+  if (libswdctx->stream.failed>0){
+   retry=LIBSWD_RETRY_COUNT_DEFAULT;
+  } else if (!--retry){
+   res=LIBSWD_ERROR_MAXRETRY;
+   goto libswd_ap_stream_stride_error;
+  } else usleep(LIBSWD_RETRY_DELAY_DEFAULT);
+  first+=libswdctx->stream.failed;
+ }
+
+ if (rdata) free(rdata);
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG, "LIBSWD_D: libswd_ap_stream_stride(*libswdctx=%p, RnW=%d, addr=0x%X, *data=%p, count=%d, stride=%d) execution OK.\n", (void*)libswdctx, RnW, (unsigned char)addr, (void*)data, count, stride);
+ libswd_stats_leave(libswdctx, LIBSWD_STATS_CLASS_DAP);
+ return count;
+
+libswd_ap_stream_stride_error:
+ libswdctx->stream.active=0;
+ if (rdata) free(rdata);
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR, "LIBSWD_E: libswd_ap_stream_stride(libswdctx=@%p, RnW=%d, addr=0x%X, count=%d, stride=%d) failed: %s.\n", (void*)libswdctx, RnW, (unsigned char)addr, count, stride, libswd_error_string(res));
+ libswd_stats_leave(libswdctx, LIBSWD_STATS_CLASS_DAP);
+ return res;
+}
+
+/** Macro function: Transfer a run of AP accesses in streaming mode.
+ * See libswd_ap_stream_stride(), data array is used word by word.
+ * \param *libswdctx swd context to work on.
+ * \param RnW is 1 for AP read, 0 for AP write.
+ * \param addr is the address of the AP register plus AP BANK on bits [4..7].
+ * \param *data array of count words to write, or to store read results.
+ * \param count number of AP accesses to perform.
+ * \return number of words transferred or LIBSWD_ERROR code on failure.
+ */
+int libswd_ap_stream(libswd_ctx_t *libswdctx, char RnW, char addr, int *data, int count){
+ return libswd_ap_stream_stride(libswdctx, RnW, addr, data, count, 1);
+}
+
+/** Macro function: Read count words from single AP register in streaming mode.
+ * \param *libswdctx swd context to work on.
+ * \param addr is the address of the AP register plus AP BANK on bits [4..7].
+ * \param *data array of count words where results will be stored.
+ * \param count number of AP reads to perform.
+ * \return number of words read or LIBSWD_ERROR code on failure.
+ */
+int libswd_ap_read_stream(libswd_ctx_t *libswdctx, char addr, int *data, int count){
+ return libswd_ap_stream(libswdctx, 1, addr, data, count);
+}
+
+/** Macro function: Write count words to single AP register in streaming mode.
+ * \param *libswdctx swd context to work on.
+ * \param addr is the address of the AP register plus AP BANK on bits [4..7].
+ * \param *data array of count words to be written.
+ * \param count number of AP writes to perform.
+ * \return number of words written or LIBSWD_ERROR code on failure.
+ */
+int libswd_ap_write_stream(libswd_ctx_t *libswdctx, char addr, int *data, int count){
+ return libswd_ap_stream(libswdctx, 0, addr, data, count);
+}
+
+/** Macro function: Write the same word count times to single AP register in streaming mode.
+ * \param *libswdctx swd context to work on.
+ * \param addr is the address of the AP register plus AP BANK on bits [4..7].
+ * \param *data pointer to the single word to be written.
+ * \param count number of AP writes to perform.
+ * \return number of words written or LIBSWD_ERROR code on failure.
+ */
+int libswd_ap_fill_stream(libswd_ctx_t *libswdctx, char addr, int *data, int count){
+ return libswd_ap_stream_stride(libswdctx, 0, addr, data, count, 0);
+}
+
+
 /** @} */
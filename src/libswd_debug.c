@@ -116,15 +116,14 @@ int libswd_debug_halt(libswd_ctx_t *libswdctx, libswd_operation_t operation)
   dbgdhcsr&=~LIBSWD_ARM_DEBUG_DHCSR_CMASKINTS;
   retval=libswd_memap_write_int_32(libswdctx, operation, LIBSWD_ARM_DEBUG_DHCSR_ADDR, 1, &dbgdhcsr);
   if (retval<0) return retval;
-  retval=libswd_memap_read_int_32(libswdctx, operation, LIBSWD_ARM_DEBUG_DHCSR_ADDR, 1, &dbgdhcsr);
+  // Wait for S_HALT with on-target compare instead of full reads.
+  retval=libswd_memap_poll(libswdctx, LIBSWD_ARM_DEBUG_DHCSR_ADDR, LIBSWD_ARM_DEBUG_DHCSR_SHALT, LIBSWD_ARM_DEBUG_DHCSR_SHALT, LIBSWD_MEMAP_POLL_TIMEOUT_DEFAULT/LIBSWD_RETRY_COUNT_DEFAULT, LIBSWD_RETRY_DELAY_DEFAULT, &dbgdhcsr);
+  if (retval==LIBSWD_ERROR_TIMEOUT) continue;
   if (retval<0) return retval;
-  if (dbgdhcsr&LIBSWD_ARM_DEBUG_DHCSR_SHALT)
-  {
-   libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO, "LIBSWD_I: libswd_debug_halt(): DHCSR=0x%08X\n", dbgdhcsr);
-   libswd_log(libswdctx, LIBSWD_LOGLEVEL_NORMAL, "LIBSWD_N: libswd_debug_halt(): TARGET HALT OK!\n");
-   libswdctx->log.debug.dhcsr=dbgdhcsr;
-   return LIBSWD_OK;
-  }
+  libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO, "LIBSWD_I: libswd_debug_halt(): DHCSR=0x%08X\n", dbgdhcsr);
+  libswd_log(libswdctx, LIBSWD_LOGLEVEL_NORMAL, "LIBSWD_N: libswd_debug_halt(): TARGET HALT OK!\n");
+  libswdctx->log.debug.dhcsr=dbgdhcsr;
+  return LIBSWD_OK;
  }
  libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR, "LIBSWD_E: libswd_debug_halt(): TARGET HALT ERROR!\n");
  return LIBSWD_ERROR_MAXRETRY;
@@ -142,6 +141,8 @@ int libswd_debug_run(libswd_ctx_t *libswdctx, libswd_operation_t operation)
   retval=libswd_debug_init(libswdctx, operation);
   if (retval<0) return retval;
  }
+ // Memory content cached while halted is no longer valid.
+ libswd_memcache_flush(libswdctx);
  // UnHalt the CPU.
  retval=libswd_memap_read_int_32(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_ARM_DEBUG_DHCSR_ADDR, 1, &dbgdhcsr);
  if (retval<0) return retval;
@@ -175,4 +176,69 @@ int libswd_debug_is_halted(libswd_ctx_t *libswdctx, libswd_operation_t operation
 }
 
 
+/** Wait for core register transfer to complete (DHCSR S_REGRDY).
+ * Transfer is usually done before DHCSR can be read, so it is checked once
+ * with a plain read (DHCSR shares Banked Data window with DCRSR/DCRDR, so
+ * no TAR write is needed) and polled only when still in progress.
+ * \param *libswdctx swd context pointer.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_debug_reg_wait(libswd_ctx_t *libswdctx)
+{
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+
+ int retval, dhcsr;
+
+ retval=libswd_memap_read_int_32(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_ARM_DEBUG_DHCSR_ADDR, 1, &dhcsr);
+ if (retval<0) return retval;
+ if (dhcsr&LIBSWD_ARM_DEBUG_DHCSR_SREGRDY) return LIBSWD_OK;
+ return libswd_memap_poll(libswdctx, LIBSWD_ARM_DEBUG_DHCSR_ADDR, LIBSWD_ARM_DEBUG_DHCSR_SREGRDY, LIBSWD_ARM_DEBUG_DHCSR_SREGRDY, LIBSWD_MEMAP_POLL_TIMEOUT_DEFAULT, 0, NULL);
+}
+
+/** Read core register through DCRSR/DCRDR, core must be halted.
+ * \param *libswdctx swd context pointer.
+ * \param reg is the register number (LIBSWD_ARM_REG_*).
+ * \param *value will hold the register value.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_debug_reg_read(libswd_ctx_t *libswdctx, int reg, int *value)
+{
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (value==NULL) return LIBSWD_ERROR_NULLPOINTER;
+ if (reg&~LIBSWD_ARM_DEBUG_DCRSR_REGSEL) return LIBSWD_ERROR_PARAM;
+
+ int retval, dcrsr=reg;
+
+ retval=libswd_memap_write_int_32(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_ARM_DEBUG_DCRSR_ADDR, 1, &dcrsr);
+ if (retval<0) return retval;
+ retval=libswd_debug_reg_wait(libswdctx);
+ if (retval<0) return retval;
+ retval=libswd_memap_read_int_32(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_ARM_DEBUG_DCRDR_ADDR, 1, value);
+ if (retval<0) return retval;
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG, "LIBSWD_D: libswd_debug_reg_read(): R%d=0x%08X\n", reg, *value);
+ return LIBSWD_OK;
+}
+
+/** Write core register through DCRDR/DCRSR, core must be halted.
+ * \param *libswdctx swd context pointer.
+ * \param reg is the register number (LIBSWD_ARM_REG_*).
+ * \param value is the new register value.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_debug_reg_write(libswd_ctx_t *libswdctx, int reg, int value)
+{
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (reg&~LIBSWD_ARM_DEBUG_DCRSR_REGSEL) return LIBSWD_ERROR_PARAM;
+
+ int retval, dcrsr=reg|LIBSWD_ARM_DEBUG_DCRSR_REGWNR;
+
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG, "LIBSWD_D: libswd_debug_reg_write(): R%d=0x%08X\n", reg, value);
+ retval=libswd_memap_write_int_32(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_ARM_DEBUG_DCRDR_ADDR, 1, &value);
+ if (retval<0) return retval;
+ retval=libswd_memap_write_int_32(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_ARM_DEBUG_DCRSR_ADDR, 1, &dcrsr);
+ if (retval<0) return retval;
+ return libswd_debug_reg_wait(libswdctx);
+}
+
+
 /** @} */
@@ -170,11 +170,52 @@ int libswd_drv_transmit(libswd_ctx_t *libswdctx, libswd_cmd_t *cmd){
  if (res<0) return res;
  cmd->done=1;
 
+ // Account wire activity, see libswd_stats_get().
+ if (cmd->cmdtype!=LIBSWD_CMDTYPE_UNDEFINED){
+  libswdctx->stats.drvcalls++;
+  libswdctx->stats.bits+=cmd->bits;
+ }
+ switch (cmd->cmdtype){
+  case LIBSWD_CMDTYPE_MOSI_REQUEST:
+   libswdctx->stats.transactions++;
+   break;
+  case LIBSWD_CMDTYPE_MISO_ACK:
+   if (cmd->ack==LIBSWD_ACK_WAIT_VAL) libswdctx->stats.waits++;
+   if (cmd->ack==LIBSWD_ACK_FAULT_VAL) libswdctx->stats.faults++;
+   break;
+  case LIBSWD_CMDTYPE_MISO_PARITY:
+   if (cmd->prev && cmd->prev->cmdtype==LIBSWD_CMDTYPE_MISO_DATA){
+    char parity;
+    if (libswd_bin32_parity_even(&cmd->prev->misodata, &parity)>=0 && parity!=cmd->parity)
+     libswdctx->stats.parity++;
+   }
+   break;
+  default:
+   break;
+ }
+
+ // Fill in the result slot bound to this command, see libswd_result_get().
+ if (cmd->result) libswd_result_update(libswdctx, cmd);
+
  /* Now verify the ACK value, notify caller about possible errors, truncate cmdq if libswdctx.config.autofixerrors is not set.
   * Accodring to ADIv5.0 specification (ARM IHI 0031A, section 5.4.5) data phase is required when STICKYORUN=1.
   * Unfortunately at this point we cannot read the CTRL/STAT flag, so we will write zeros to avoid random Request.
   */
  if (cmd->cmdtype==LIBSWD_CMDTYPE_MISO_ACK){
+  // In overrun detection streaming mode the data phase is already enqueued
+  // for every transaction, so only remember the first ACK!=OK and go on.
+  // Stream owner verifies CTRL/STAT:STICKYORUN once at the end.
+  if (libswdctx->stream.active){
+   if (cmd->ack!=LIBSWD_ACK_OK_VAL && libswdctx->stream.failed<0){
+    libswdctx->stream.failed=libswdctx->stream.count;
+    libswdctx->stream.ack=cmd->ack;
+    libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG,
+      "LIBSWD_D: libswd_drv_transmit(libswdctx=@%p, cmd=@%p): Stream transaction %d got ACK=%d, deferring...\n",
+      (void*)libswdctx, (void*)cmd, libswdctx->stream.count, cmd->ack );
+   }
+   libswdctx->stream.count++;
+   return res;
+  }
   switch(cmd->ack){
    // If the ACK was OK then simply return to the caller.
    case LIBSWD_ACK_OK_VAL: return res;
@@ -247,6 +288,8 @@ int libswd_drv_transmit(libswd_ctx_t *libswdctx, libswd_cmd_t *cmd){
   * If error was detected, delete trailing queue elements.
   */
  if (cmd->cmdtype==LIBSWD_CMDTYPE_MISO_PARITY){
+  // Data phases after rejected stream transaction are not driven by target.
+  if (libswdctx->stream.active && libswdctx->stream.failed>=0) return res;
   // Parity must be preceded with data, look for that data and verify parity.
   if (cmd->prev->cmdtype==LIBSWD_CMDTYPE_MISO_DATA){
    char testparity;
@@ -88,6 +88,9 @@ char *libswd_error_string(libswd_error_code_t error){
   case LIBSWD_ERROR_UNSUPPORTED:  return "[LIBSWD_ERROR_UNSUPPORTED] Target not supported";
   case LIBSWD_ERROR_MEMAPACCSIZE: return "[LIBSWD_ERROR_MEMAPACCSIZE] Invalid MEM-AP access size";
   case LIBSWD_ERROR_MEMAPALIGN:   return "[LIBSWD_ERROR_MEMAPALIGN] Invalid address alignment for access size";
+  case LIBSWD_ERROR_TIMEOUT:      return "[LIBSWD_ERROR_TIMEOUT] operation deadline exceeded";
+  case LIBSWD_ERROR_MISMATCH:     return "[LIBSWD_ERROR_MISMATCH] value match failed";
+  case LIBSWD_ERROR_WORKAREA:     return "[LIBSWD_ERROR_WORKAREA] target work area not set or too small";
   default:                        return "undefined error";
  }
  return "undefined error";
@@ -150,6 +153,14 @@ int libswd_error_handle_ack(libswd_ctx_t *libswdctx){
  }
 }
 
+/** Handle ACK WAIT found on the queue when autofixerrors is set.
+ * Identical request is reissued by libswd_dap_retry_wait() on a separate
+ * queue attached to the bad ACK element (cmd->errors), then the original
+ * ACK, DATA and PARITY elements are updated with the retry result and marked
+ * as done, so the rest of the original queue can be flushed as usual.
+ * \param *libswdctx swd context pointer, cmdq must point to the WAIT ACK.
+ * \return LIBSWD_OK on success, or LIBSWD_ERROR code on failure.
+ */
 int libswd_error_handle_ack_wait(libswd_ctx_t *libswdctx){
  if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
  // Make sure we are working on the ACK cmdq element.
@@ -163,89 +174,52 @@ int libswd_error_handle_ack_wait(libswd_ctx_t *libswdctx){
   return LIBSWD_ERROR_ACKMISMATCH;
  }
 
- //TODO: NOW DECIDE IF AN OPERATION WAS READ OR WRITE AND PERFORM RETRY ACCORDINGLY
- // READ AND WRITE WILL HAVE DIFFERENT RETRY SEQUENCES
-
- char request = libswdctx->cmdq->prev->prev->request;
- char *ack, *rparity;
- char parity=0;
-
- // Remember original cmdq, restore on return.
- libswd_cmd_t *mastercmdq = libswdctx->cmdq;
-
- // Append dummy data phase, fix sticky flags and retry operation.
- int retval=0, *ctrlstat, *rdata, abort, retrycnt=50;
-// retval=libswd_cmdq_init(errors);
- libswdctx->cmdq->errors=(libswd_cmd_t*)calloc(1,sizeof(libswd_cmd_t));
- //retval = LIBSWD_ERROR_OUTOFMEM;
- if (libswdctx->cmdq->errors==NULL) goto libswd_error_handle_ack_wait_end;
- libswdctx->cmdq=libswdctx->cmdq->errors; // From now, this becomes out main cmdq for use with standard functions.
- libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG, "LIBSWD_D: libswd_error_handle_ack_wait(libswdctx=@%p): Performing data phase after ACK={WAIT,FAULT}...\n", (void*)libswdctx);
- int data=0;
- retval=libswd_bus_write_data_p(libswdctx, LIBSWD_OPERATION_EXECUTE, &data, &parity);
- if (retval<0) goto libswd_error_handle_ack_wait_end;
-
- // NOW WE CAN HANDLE MEM-AP READ RETRY:
- // 1. READ STICKY FLAGS FROM CTRL/STAT
- // 2. CLEAR STICKY FLAGS IN ABORT - this will discard AP transaction
- // 3. RETRY MEM-AP DRW READ - now it must be ACK=OK (it will return last mem-ap read result).
- // 4. READ DP RDBUFF TO OBTAIN READ DATA
-
- for (retrycnt=50/*LIBSWD_RETRY_COUNT_DEFAULT*/; retrycnt>0; retrycnt--){
-  retval=libswd_dp_read(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_DP_CTRLSTAT_ADDR, &ctrlstat);
-  if (retval<0) goto libswd_error_handle_ack_wait_end;
-  abort=0x00000014;
-  retval=libswd_dp_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_DP_ABORT_ADDR, &abort);
-  if (retval<0) goto libswd_error_handle_ack_wait_end;
-  retval=libswd_bus_write_request_raw(libswdctx, LIBSWD_OPERATION_ENQUEUE, &request);
-  retval=libswd_bus_read_ack(libswdctx, LIBSWD_OPERATION_EXECUTE, &ack);
-  if (retval<0 || *ack!=LIBSWD_ACK_OK_VAL) goto libswd_error_handle_ack_wait_end;
-  retval=libswd_bus_read_data_p(libswdctx, LIBSWD_OPERATION_EXECUTE, &rdata, &rparity);
-  if (retval<0) goto libswd_error_handle_ack_wait_end;
-
-  retval=libswd_dp_read(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_DP_CTRLSTAT_ADDR, &ctrlstat);
-  if (retval<0) goto libswd_error_handle_ack_wait_end;
-
-
-  if (*ctrlstat&LIBSWD_DP_CTRLSTAT_READOK){
-   libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG, "=========================GOT RESPONSE===========================\n\n\n");
-   retval=libswd_dp_read(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_DP_RDBUFF_ADDR, &rdata);
-   if (retval<0) goto libswd_error_handle_ack_wait_end;
-   break;
-  }
- }
- if (retrycnt==0){
-  retval=LIBSWD_ERROR_MAXRETRY;
-  goto libswd_error_handle_ack_wait_end;
+ int retval, data=0, zero=0, *rdata=NULL;
+ char request, RnW, autofix, parity=0, *rparity=NULL;
+ libswd_cmd_t *ackcmd=libswdctx->cmdq, *datacmd, *cmd;
+
+ // Find the request that caused WAIT, it will be reissued as-is.
+ for (cmd=ackcmd->prev; cmd && cmd->cmdtype!=LIBSWD_CMDTYPE_MOSI_REQUEST; cmd=cmd->prev);
+ if (cmd==NULL) return LIBSWD_ERROR_ACKORDER;
+ request=cmd->request;
+ RnW=(request&LIBSWD_REQUEST_RnW)?1:0;
+ // Find the original data phase, it will hold the retry result.
+ for (datacmd=ackcmd->next; datacmd; datacmd=datacmd->next)
+  if (datacmd->cmdtype==LIBSWD_CMDTYPE_MISO_DATA || datacmd->cmdtype==LIBSWD_CMDTYPE_MOSI_DATA) break;
+ if (datacmd==NULL || datacmd->next==NULL) return LIBSWD_ERROR_NODATACMD;
+ if (!RnW) data=datacmd->mosidata;
+
+ // Retry is performed on a separate queue attached to the bad ACK element.
+ ackcmd->errors=(libswd_cmd_t*)calloc(1,sizeof(libswd_cmd_t));
+ if (ackcmd->errors==NULL) return LIBSWD_ERROR_OUTOFMEM;
+ libswdctx->cmdq=ackcmd->errors;
+ // Data phase after WAIT is only expected with ORUNDETECT=1 and its content
+ // is ignored, so zeros are sent. Write data go to the reissued request only.
+ retval=LIBSWD_OK;
+ if (libswdctx->log.dp.ctrlstat&LIBSWD_DP_CTRLSTAT_ORUNDETECT){
+  libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG, "LIBSWD_D: libswd_error_handle_ack_wait(libswdctx=@%p): Performing data phase after ACK=WAIT...\n", (void*)libswdctx);
+  retval=libswd_bus_write_data_p(libswdctx, LIBSWD_OPERATION_ENQUEUE, &zero, &parity);
  }
-
- //Make sure we have RDATA and PARITY elements after libswdctx->cmdq.
- //Should we check for this at the procedure start???
- libswdctx->cmdq=mastercmdq;
- if (libswdctx->cmdq->cmdtype==LIBSWD_CMDTYPE_MISO_ACK && libswdctx->cmdq->next->cmdtype==LIBSWD_CMDTYPE_MISO_DATA && libswdctx->cmdq->next->next->cmdtype==LIBSWD_CMDTYPE_MISO_PARITY){
-  libswdctx->cmdq->ack=LIBSWD_ACK_OK_VAL;
-  libswdctx->cmdq=libswdctx->cmdq->next;
-  libswdctx->cmdq->misodata=*rdata;
-  libswdctx->cmdq->done=1;
-  libswdctx->cmdq=libswdctx->cmdq->next;
-  //libswd_bin8_parity_even(rdata, &parity);
-  libswdctx->cmdq->parity=*rparity;
-  libswdctx->cmdq->done=1;
-  return LIBSWD_OK;
- } else libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR, "LIBSWD_E: UNSUPPORTED COMMAND SEQUENCE ON CMDQ (NOT ACK->RDATA->PARITY)\n");
-
-
- // At this point we should have the read result from RDBUFF ready for MEM-AP read fix.
-
-
-libswd_error_handle_ack_wait_end:
- // Exit ACK WAIT handling routine, verify retval before return.
- if (retval<0||retrycnt==0){
+ // WAIT on the retry itself is handled by the retry loop, not recursively here.
+ autofix=libswdctx->config.autofixerrors;
+ libswdctx->config.autofixerrors=0;
+ if (retval>=0) retval=libswd_dap_retry_wait(libswdctx, request, &data, &rdata, &rparity);
+ libswdctx->config.autofixerrors=autofix;
+ libswdctx->cmdq=ackcmd;
+ if (retval<0){
   libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR, "LIBSWD_E: libswd_error_handle_ack_wait(libswdctx=@%p) ejecting: %s\n", (void*)libswdctx, libswd_error_string(retval));
+  return retval;
  }
 
- libswdctx->cmdq=mastercmdq;
- while (1) {printf("ACK WAIT HANDLER\n");usleep(1000);}
- return retval;
+ // Original transaction is now complete, update it and skip on flush.
+ ackcmd->ack=LIBSWD_ACK_OK_VAL;
+ for (cmd=ackcmd->next; cmd!=datacmd->next; cmd=cmd->next) cmd->done=1;
+ if (RnW){
+  datacmd->misodata=*rdata;
+  datacmd->next->parity=*rparity;
+ }
+ datacmd->next->done=1;
+ return LIBSWD_OK;
 }
+
 /** @} */
@@ -209,4 +209,134 @@ const char *libswd_request_string(libswd_ctx_t *libswdctx, char request){
 }
 
 
+/** @} */
+
+
+/*******************************************************************************
+ * \defgroup libswd_stats Transfer statistics and progress reporting.
+ * Counters are kept in libswdctx->stats and updated where things happen:
+ * libswd_drv_transmit() counts wire bits, driver calls and ACK/parity events,
+ * libswd_cmdq_flush() counts round trips, MEM-AP engines count bytes.
+ * Time is accumulated per API class only at the outermost call of the class,
+ * so nested calls of the same class are not counted twice. Classes do nest
+ * in each other (MEM-AP time includes its bus time).
+ * @{
+ ******************************************************************************/
+
+/** Return timestamp used by the statistics.
+ * \return current time [us].
+ */
+unsigned long long libswd_stats_time(void){
+ struct timeval tv;
+ gettimeofday(&tv, NULL);
+ return (unsigned long long)tv.tv_sec*1000000+tv.tv_usec;
+}
+
+/** Mark entry into the API class for time accounting.
+ * Every call must be paired with libswd_stats_leave() of the same class.
+ * \param *libswdctx swd context.
+ * \param apiclass is the LIBSWD_STATS_CLASS_* to account.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_stats_enter(libswd_ctx_t *libswdctx, int apiclass){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (apiclass<0 || apiclass>=LIBSWD_STATS_CLASSES) return LIBSWD_ERROR_PARAM;
+ if (libswdctx->statsctl.depth[apiclass]++==0)
+  libswdctx->statsctl.start[apiclass]=libswd_stats_time();
+ return LIBSWD_OK;
+}
+
+/** Mark exit from the API class and accumulate its time on outermost exit.
+ * \param *libswdctx swd context.
+ * \param apiclass is the LIBSWD_STATS_CLASS_* to account.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_stats_leave(libswd_ctx_t *libswdctx, int apiclass){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (apiclass<0 || apiclass>=LIBSWD_STATS_CLASSES) return LIBSWD_ERROR_PARAM;
+ if (libswdctx->statsctl.depth[apiclass]<=0) return LIBSWD_ERROR_PARAM;
+ if (--libswdctx->statsctl.depth[apiclass]==0)
+  libswdctx->stats.time[apiclass]+=libswd_stats_time()-libswdctx->statsctl.start[apiclass];
+ return LIBSWD_OK;
+}
+
+/** Copy out current transfer statistics.
+ * \param *libswdctx swd context.
+ * \param *stats where to store the statistics snapshot.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_stats_get(libswd_ctx_t *libswdctx, libswd_stats_t *stats){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (stats==NULL) return LIBSWD_ERROR_NULLPOINTER;
+ *stats=libswdctx->stats;
+ return LIBSWD_OK;
+}
+
+/** Clear transfer statistics.
+ * Calls in progress keep their accounting and are added on exit.
+ * \param *libswdctx swd context.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_stats_reset(libswd_ctx_t *libswdctx){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ memset(&libswdctx->stats, 0, sizeof(libswd_stats_t));
+ return LIBSWD_OK;
+}
+
+/** Install progress callback invoked by long MEM-AP transfers.
+ * Callback gets number of bytes done and total bytes of the current call,
+ * it is invoked at most once per interval and always at transfer end.
+ * \param *libswdctx swd context.
+ * \param *progress callback function, NULL disables progress reporting.
+ * \param *priv private data passed to the callback.
+ * \param interval minimal time between two invocations [us], 0 for default.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_stats_progress_set(libswd_ctx_t *libswdctx, void (*progress)(void *libswdctx, void *priv, int done, int total), void *priv, int interval){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (interval<0) return LIBSWD_ERROR_PARAM;
+ libswdctx->statsctl.progress=progress;
+ libswdctx->statsctl.priv=priv;
+ libswdctx->statsctl.interval=interval?interval:LIBSWD_STATS_PROGRESS_DEFAULT;
+ libswdctx->statsctl.last=0;
+ return LIBSWD_OK;
+}
+
+/** Report transfer progress through the callback if installed and due.
+ * Without callback this is a no-op, so it is cheap to call per window.
+ * \param *libswdctx swd context.
+ * \param done number of bytes transferred so far.
+ * \param total number of bytes to transfer.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_stats_progress(libswd_ctx_t *libswdctx, int done, int total){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (libswdctx->statsctl.progress==NULL) return LIBSWD_OK;
+ unsigned long long now=libswd_stats_time();
+ if (done<total && now-libswdctx->statsctl.last<(unsigned long long)libswdctx->statsctl.interval)
+  return LIBSWD_OK;
+ libswdctx->statsctl.last=now;
+ libswdctx->statsctl.progress((void*)libswdctx, libswdctx->statsctl.priv, done, total);
+ return LIBSWD_OK;
+}
+
+/** Log transfer statistics summary at LIBSWD_LOGLEVEL_NORMAL.
+ * \param *libswdctx swd context.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_stats_print(libswd_ctx_t *libswdctx){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ libswd_stats_t *s=&libswdctx->stats;
+ unsigned long long t=s->time[LIBSWD_STATS_CLASS_MEMAP];
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_NORMAL, "LIBSWD_N: Bytes: %llu (%llu KB/s MEM-AP)\n", s->bytes, t?s->bytes*1000/t:0);
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_NORMAL, "LIBSWD_N: Transactions: %llu, Bits: %llu\n", s->transactions, s->bits);
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_NORMAL, "LIBSWD_N: Driver calls: %llu, Round trips: %llu\n", s->drvcalls, s->roundtrips);
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_NORMAL, "LIBSWD_N: WAIT: %lu, FAULT: %lu, Parity errors: %lu\n", s->waits, s->faults, s->parity);
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_NORMAL, "LIBSWD_N: WAIT retries: %lu (max %lu), recovered: %lu, aborts: %lu, time [us]: %llu\n", s->retries, s->maxretries, s->recovered, s->aborts, s->waittime);
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_NORMAL, "LIBSWD_N: Time [us]: bus %llu, dap %llu, memap %llu\n",
+            s->time[LIBSWD_STATS_CLASS_BUS], s->time[LIBSWD_STATS_CLASS_DAP], s->time[LIBSWD_STATS_CLASS_MEMAP]);
+ return LIBSWD_OK;
+}
+
+
 /** @} */
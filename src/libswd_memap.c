@@ -35,6 +35,10 @@
 /** \file libswd_memap.c MEM-AP related routines. */
 
 #include <libswd.h>
+#include <config.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 /*******************************************************************************
  * \defgroup libswd_memap High-level MEM-AP (Memory Access Port) operations.
@@ -56,7 +60,7 @@ int libswd_memap_init(libswd_ctx_t *libswdctx, libswd_operation_t operation){
 
  if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
 
- int res=0, *memapidr, *memapbase, *memapcswp, memapcsw;
+ int res=0, *memapidr, *memapbase, *memapcfg, *memapcswp, memapcsw;
 
  // Verify if DAP is already initialized, do so in necessary.
  if (!libswdctx->log.dp.initialized)
@@ -66,10 +70,9 @@ int libswd_memap_init(libswd_ctx_t *libswdctx, libswd_operation_t operation){
   if (res<0) goto libswd_memap_init_error;
  }
 
- // Select MEM-AP.
- //res=libswd_ap_select(libswdctx, operation, LIBSWD_MEMAP_APSEL_VAL);
- //if (res<0) goto libswd_memap_init_error;
- // TODO: DO WE NEED LIBSWD_AP_SELECT ???
+ // Select MEM-AP, this is APSEL 0 unless changed with libswd_memap_select().
+ res=libswd_ap_select(libswdctx, operation, libswdctx->aptable.current);
+ if (res<0) goto libswd_memap_init_error;
 
  // Check IDentification Register, use cached value if possible.
  if (!libswdctx->log.memap.idr)
@@ -93,6 +96,22 @@ int libswd_memap_init(libswd_ctx_t *libswdctx, libswd_operation_t operation){
             "LIBSWD_I: libswd_memap_init(): MEM-AP BASE=0x%08X\n",
              libswdctx->log.memap.base );
 
+ // Check Configuration Register for target byte order, scan result is used if available.
+ if (libswdctx->aptable.scanned && libswdctx->aptable.ap[libswdctx->aptable.current].present)
+  libswdctx->log.memap.cfg=libswdctx->aptable.ap[libswdctx->aptable.current].cfg;
+ else
+ {
+  res=libswd_ap_read(libswdctx, operation, LIBSWD_MEMAP_CFG_ADDR, &memapcfg);
+  if (res<0) goto libswd_memap_init_error;
+  libswdctx->log.memap.cfg=*memapcfg;
+ }
+ // Memory images are kept in target byte order, words on host in host order.
+ libswdctx->log.memap.bswap=((libswdctx->log.memap.cfg&LIBSWD_MEMAP_CFG_BIGENDIAN)?1:0)!=libswd_bin_bigendian();
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO,
+            "LIBSWD_I: libswd_memap_init(): MEM-AP  CFG=0x%08X (%s-endian target)\n",
+            libswdctx->log.memap.cfg,
+            (libswdctx->log.memap.cfg&LIBSWD_MEMAP_CFG_BIGENDIAN)?"big":"little" );
+
  // Setup the CSW (MEM-AP Control and Status) register.
  memapcsw=0;
  // Check if DbgSwEnable bit is set, set if necessary.
@@ -111,6 +130,9 @@ int libswd_memap_init(libswd_ctx_t *libswdctx, libswd_operation_t operation){
             "LIBSWD_I: libswd_memap_init(): MEM-AP  CSW=0x%08X\n",
             libswdctx->log.memap.csw);
 
+ // TAR value is left by whoever used MEM-AP before.
+ libswdctx->log.memap.tar=LIBSWD_MEMAP_TAR_UNKNOWN;
+
  // Mark MEM-AP as configured.
  libswdctx->log.memap.initialized=1;
 
@@ -128,6 +150,7 @@ libswd_memap_init_error:
  * This setup needs to be done before MEM-AP with different access size.
  * Function will try to compare agains chahed values to save bus traffic.
  * This function will set DBGSWENABLE and PROT bits in CSW by default.
+ * Packed AddrInc falls back to single increment when MEM-AP does not support it.
  * \param *libswd LibSWD context to work on.
  * \param operation is the LIBSWD_OPERATION type.
  * \param csw is the CSW register value to be set.
@@ -153,9 +176,12 @@ int libswd_memap_setup(libswd_ctx_t *libswdctx, libswd_operation_t operation, in
  // Remember to set these bits not to lock-out the Debug...
  memapcsw=csw|LIBSWD_MEMAP_CSW_DBGSWENABLE;
  memapcsw|=LIBSWD_MEMAP_CSW_PROT; // PROT ENABLES DEBUG!!
+ // Use single increment right away when packed transfers are known not to work.
+ if (libswdctx->log.memap.packed<0 && (memapcsw&LIBSWD_MEMAP_CSW_ADDRINC)==LIBSWD_MEMAP_CSW_ADDRINC_PACKED)
+  memapcsw=(memapcsw&~LIBSWD_MEMAP_CSW_ADDRINC)|LIBSWD_MEMAP_CSW_ADDRINC_SINGLE;
 
- // Update MEM-AP CSW register if necessary.
- if (memapcsw!=libswdctx->log.memap.csw)
+ // Update MEM-AP CSW register if necessary, read-only status bits do not count.
+ if ((memapcsw^libswdctx->log.memap.csw)&~(LIBSWD_MEMAP_CSW_SPIDEN|LIBSWD_MEMAP_CSW_TRINPROG|LIBSWD_MEMAP_CSW_DEVICEEN))
  {
   // Write register value.
   res=libswd_ap_write(libswdctx, operation, LIBSWD_MEMAP_CSW_ADDR, &memapcsw);
@@ -164,6 +190,26 @@ int libswd_memap_setup(libswd_ctx_t *libswdctx, libswd_operation_t operation, in
   res=libswd_ap_read(libswdctx, operation, LIBSWD_MEMAP_CSW_ADDR, &memapcswp);
   if (res<0) goto libswd_memap_setup_error;
   libswdctx->log.memap.csw=(*memapcswp);
+  // Packed transfers are optional, CSW AddrInc reads back different when not supported.
+  if ((memapcsw&LIBSWD_MEMAP_CSW_ADDRINC)==LIBSWD_MEMAP_CSW_ADDRINC_PACKED)
+  {
+   if ((libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_ADDRINC)==LIBSWD_MEMAP_CSW_ADDRINC_PACKED)
+   {
+    libswdctx->log.memap.packed=1;
+   }
+   else
+   {
+    libswd_log(libswdctx, LIBSWD_LOGLEVEL_WARNING,
+               "LIBSWD_W: libswd_memap_setup(): Packed transfers not supported, falling back to single increment.\n" );
+    libswdctx->log.memap.packed=-1;
+    memapcsw=(memapcsw&~LIBSWD_MEMAP_CSW_ADDRINC)|LIBSWD_MEMAP_CSW_ADDRINC_SINGLE;
+    res=libswd_ap_write(libswdctx, operation, LIBSWD_MEMAP_CSW_ADDR, &memapcsw);
+    if (res<0) goto libswd_memap_setup_error;
+    res=libswd_ap_read(libswdctx, operation, LIBSWD_MEMAP_CSW_ADDR, &memapcswp);
+    if (res<0) goto libswd_memap_setup_error;
+    libswdctx->log.memap.csw=(*memapcswp);
+   }
+  }
  }
 
  // Update MEM-AP TAR register if necessary.
@@ -188,9 +234,338 @@ libswd_memap_setup_error:
 }
 
 
+/** Probe the TAR auto increment wrap size of the current MEM-AP.
+ * ADIv5 only guarantees auto increment on the bottom 10 bits of TAR, but
+ * many implementations wrap at 4KB or more. TAR is set to the last word
+ * below each power of two boundary of the RAM region, one DRW read is made
+ * and TAR is read back to see if increment carried over the boundary.
+ * Only reads are made, up to addr+size-4. Result is stored in the MEM-AP
+ * cache (log.memap.tarwrap, kept per AP) and used by the block engines.
+ * \param *libswdctx swd context to work on.
+ * \param addr is the start address of the readable RAM region.
+ * \param size is the RAM region size [bytes].
+ * \return wrap size in bytes on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_memap_tarwrap(libswd_ctx_t *libswdctx, int addr, int size){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG,
+            "LIBSWD_D: Entering libswd_memap_tarwrap(*libswdctx=%p, addr=0x%08X, size=0x%08X)...\n",
+            (void*)libswdctx, addr, size );
+
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (addr&(LIBSWD_MEMAP_TARWRAP_MIN-1)) return LIBSWD_ERROR_MEMAPALIGN;
+
+ int res, csw, loc, wrap, boundary, *memapdrw, *memaptar;
+
+ // Initialize MEM-AP if necessary.
+ if (!libswdctx->log.memap.initialized)
+ {
+  res=libswd_memap_init(libswdctx, LIBSWD_OPERATION_EXECUTE);
+  if (res<0) return res;
+ }
+ csw=libswdctx->log.memap.csw;
+ res=libswd_memap_setup(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_CSW_SIZE_32BIT|LIBSWD_MEMAP_CSW_ADDRINC_SINGLE, libswdctx->log.memap.tar);
+ if (res<0) goto libswd_memap_tarwrap_error;
+
+ // Crossing the boundary inside aligned region means wrap is at least twice that big.
+ wrap=LIBSWD_MEMAP_TARWRAP_MIN;
+ for (boundary=LIBSWD_MEMAP_TARWRAP_MIN; boundary*2<=LIBSWD_MEMAP_TARWRAP_MAX; boundary*=2)
+ {
+  if (boundary>size || (addr&(boundary*2-1))) break;
+  loc=addr+boundary-4;
+  res=libswd_ap_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_TAR_ADDR, &loc);
+  if (res<0) goto libswd_memap_tarwrap_error;
+  res=libswd_ap_read(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_DRW_ADDR, &memapdrw);
+  if (res<0) goto libswd_memap_tarwrap_error;
+  res=libswd_ap_read(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_TAR_ADDR, &memaptar);
+  if (res<0) goto libswd_memap_tarwrap_error;
+  libswdctx->log.memap.tar=*memaptar;
+  if (*memaptar!=addr+boundary) break;
+  wrap=boundary*2;
+ }
+ libswdctx->log.memap.tarwrap=wrap;
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO,
+            "LIBSWD_I: libswd_memap_tarwrap(): TAR auto increment wraps at %d bytes\n",
+            wrap );
+
+ // Restore CSW of the caller.
+ res=libswd_memap_setup(libswdctx, LIBSWD_OPERATION_EXECUTE, csw, libswdctx->log.memap.tar);
+ if (res<0) goto libswd_memap_tarwrap_error;
+ return wrap;
+
+libswd_memap_tarwrap_error:
+ // Leave the caller CSW in the MEM-AP also when probe fails.
+ libswd_memap_setup(libswdctx, LIBSWD_OPERATION_EXECUTE, csw, libswdctx->log.memap.tar);
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR,
+            "LIBSWD_E: libswd_memap_tarwrap(): %s\n",
+            libswd_error_string(res) );
+ return res;
+}
+
+
+/** Select the MEM-AP to be used by subsequent MEM-AP operations.
+ * Each AP has its own cached MEM-AP registers (CSW, TAR, ...) kept in
+ * libswdctx->aptable, so switching between APs (ie. system and debug AP on
+ * multi-core parts) does not need to re-initialize or re-setup the MEM-AP.
+ * \param *libswdctx swd context to work on.
+ * \param operation is the LIBSWD_OPERATION type.
+ * \param ap is the APSEL of the MEM-AP to use.
+ * \return LIBSWD_OK on success, LIBSWD_ERROR otherwise.
+ */
+int libswd_memap_select(libswd_ctx_t *libswdctx, libswd_operation_t operation, int ap){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG,
+            "LIBSWD_D: Entering libswd_memap_select(*libswdctx=%p, operation=%s, ap=%d)...\n",
+            (void*)libswdctx, libswd_operation_string(operation), ap );
+
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (ap<0 || ap>=LIBSWD_AP_COUNT) return LIBSWD_ERROR_PARAM;
+
+ int res;
+
+ if (libswdctx->aptable.scanned && !libswdctx->aptable.ap[ap].present)
+ {
+  libswd_log(libswdctx, LIBSWD_LOGLEVEL_WARNING,
+             "LIBSWD_W: libswd_memap_select(): AP[%d] was not found by libswd_ap_scan()!\n", ap );
+ }
+ else if (libswdctx->aptable.scanned
+          && libswdctx->aptable.ap[ap].apclass!=LIBSWD_AP_IDR_CLASS_MEMAP_VAL)
+ {
+  libswd_log(libswdctx, LIBSWD_LOGLEVEL_WARNING,
+             "LIBSWD_W: libswd_memap_select(): AP[%d] is not a MEM-AP (IDR=0x%08X)!\n",
+             ap, libswdctx->aptable.ap[ap].idr );
+ }
+
+ // Swap cached MEM-AP registers of the previous and the new AP.
+ if (ap!=libswdctx->aptable.current)
+ {
+  libswdctx->aptable.ap[libswdctx->aptable.current].memap=libswdctx->log.memap;
+  libswdctx->log.memap=libswdctx->aptable.ap[ap].memap;
+  libswdctx->aptable.current=ap;
+ }
+
+ res=libswd_ap_select(libswdctx, operation, ap);
+ if (res<0) goto libswd_memap_select_error;
+
+ return LIBSWD_OK;
+
+libswd_memap_select_error:
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR,
+            "LIBSWD_E: libswd_memap_select(): Cannot select AP[%d] (%s)!\n",
+            ap, libswd_error_string(res) );
+ return res;
+}
+
+/** Decide whether MEM-AP block transfer can be resumed after a failure.
+ * Error is stored in libswdctx->memapresult along with the failing address,
+ * it is cleared when the resumed transfer completes, then only
+ * memapresult.resumes tells that a fault happened.
+ * Only transfer errors (ACK FAULT, parity, unknown ACK) are resumable and
+ * only up to config.memapresume times per block transfer. When resume is
+ * allowed sticky error flags are cleared (without DAPABORT) so the caller
+ * can rewrite TAR at the failing address and continue from there.
+ * \param *libswdctx swd context to work on.
+ * \param error is the error code that caused the transfer to stop.
+ * \param addr is the address of the failing word.
+ * \return LIBSWD_OK if transfer can continue, error code otherwise.
+ */
+int libswd_memap_resume(libswd_ctx_t *libswdctx, int error, int addr){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+
+ int res, abort, ctrlstat;
+
+ libswdctx->memapresult.error=error;
+ libswdctx->memapresult.addr=addr;
+ if (error!=LIBSWD_ERROR_ACK_FAULT && error!=LIBSWD_ERROR_PARITY && error!=LIBSWD_ERROR_ACKUNKNOWN)
+  return error;
+ if (libswdctx->memapresult.resumes>=libswdctx->config.memapresume)
+  return error;
+
+ // Clear all possible error flags, but don't abort transaction.
+ abort=0xFFFFFFFE;
+ res=libswd_dap_errors_handle(libswdctx, LIBSWD_OPERATION_EXECUTE, &abort, &ctrlstat);
+ if (res<0) return error;
+ libswdctx->memapresult.resumes++;
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_WARNING,
+            "LIBSWD_W: libswd_memap_resume(): %s at 0x%08X, resuming (%d/%d)...\n",
+            libswd_error_string(error), addr,
+            libswdctx->memapresult.resumes, libswdctx->config.memapresume );
+ return LIBSWD_OK;
+}
+
+
+/** Access a single word through the Banked Data registers.
+ * Words of an aligned 16-byte window are mapped to BD0..BD3, so TAR is
+ * written only when the window changes. Clustered register accesses, like
+ * the Cortex-M debug registers DHCSR/DCRSR/DCRDR/DEMCR, then need no TAR
+ * write at all. CSW must be set for 32-bit access.
+ * \param *libswdctx swd context to work on.
+ * \param RnW is 1 for read, 0 for write.
+ * \param addr is the word aligned address to access.
+ * \param *data is the pointer to the value to write or where to store the value read.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_memap_bd(libswd_ctx_t *libswdctx, char RnW, int addr, int *data){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG,
+            "LIBSWD_D: Entering libswd_memap_bd(*libswdctx=%p, RnW=%d, addr=0x%08X, *data=%p)...\n",
+            (void*)libswdctx, RnW, addr, (void*)data);
+
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (data==NULL) return LIBSWD_ERROR_NULLPOINTER;
+ if (addr&3) return LIBSWD_ERROR_MEMAPALIGN;
+ if ((libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_SIZE)!=LIBSWD_MEMAP_CSW_SIZE_32BIT)
+  return LIBSWD_ERROR_MEMAPACCSIZE;
+
+ int res, window, bd, *value;
+
+ window=addr&~(LIBSWD_MEMAP_BD_WINDOW-1);
+ bd=LIBSWD_MEMAP_BD0_ADDR+(addr&(LIBSWD_MEMAP_BD_WINDOW-1));
+ if (!RnW) libswd_memcache_invalidate(libswdctx, addr, 4);
+ libswd_stats_enter(libswdctx, LIBSWD_STATS_CLASS_MEMAP);
+ while (1)
+ {
+  // Pass window address to TAR register if necessary.
+  res=LIBSWD_OK;
+  if (libswdctx->log.memap.tar!=window)
+  {
+   res=libswd_ap_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_TAR_ADDR, &window);
+   libswdctx->log.memap.tar=(res<0)?LIBSWD_MEMAP_TAR_UNKNOWN:window;
+  }
+  if (res>=0)
+  {
+   if (RnW)
+   {
+    res=libswd_ap_read(libswdctx, LIBSWD_OPERATION_EXECUTE, bd, &value);
+    if (res>=0) *data=*value;
+   }
+   else res=libswd_ap_write(libswdctx, LIBSWD_OPERATION_EXECUTE, bd, data);
+  }
+  if (res>=0) break;
+  // Clear errors and retry the access if policy allows.
+  libswdctx->log.memap.tar=LIBSWD_MEMAP_TAR_UNKNOWN;
+  res=libswd_memap_resume(libswdctx, res, addr);
+  if (res<0) goto libswd_memap_bd_error;
+ }
+
+ switch (bd)
+ {
+  case LIBSWD_MEMAP_BD0_ADDR: libswdctx->log.memap.bd0=*data; break;
+  case LIBSWD_MEMAP_BD1_ADDR: libswdctx->log.memap.bd1=*data; break;
+  case LIBSWD_MEMAP_BD2_ADDR: libswdctx->log.memap.bd2=*data; break;
+  case LIBSWD_MEMAP_BD3_ADDR: libswdctx->log.memap.bd3=*data; break;
+ }
+ if (libswdctx->statsctl.depth[LIBSWD_STATS_CLASS_MEMAP]==1) libswdctx->stats.bytes+=4;
+ libswdctx->memapresult.error=LIBSWD_OK;
+ libswd_stats_leave(libswdctx, LIBSWD_STATS_CLASS_MEMAP);
+ return LIBSWD_OK;
+
+libswd_memap_bd_error:
+ libswdctx->memapresult.error=res;
+ libswd_stats_leave(libswdctx, LIBSWD_STATS_CLASS_MEMAP);
+ return res;
+}
+
+
+/** Pipelined MEM-AP block read engine, reads count DRW transfers from addr.
+ * TAR is written once per auto increment window (see libswd_memap_tarwrap()),
+ * by default 1024 bytes guaranteed by ADIv5, and the whole
+ * window is read with back-to-back posted DRW reads in one queue flush
+ * (see libswd_ap_read_stream()), so each word costs single transaction.
+ * Without TAR auto increment each transfer is a window of its own.
+ * When a window fails it is replayed transfer by transfer to locate the
+ * failing address, then libswd_memap_resume() policy applies.
+ * Progress is stored in libswdctx->memapresult (done transfers, address).
+ * Remember to setup CSW first for valid bus access!
+ * \param *libswdctx swd context to work on.
+ * \param addr is the start address of the data to read with MEM-AP.
+ * \param count is the number of DRW transfers to perform.
+ * \param *data is the pointer to int array where raw DRW values will be stored.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_memap_read_block(libswd_ctx_t *libswdctx, int addr, int count, int *data){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG,
+            "LIBSWD_D: Entering libswd_memap_read_block(*libswdctx=%p, addr=0x%08X, count=0x%08X, *data=%p)...\n",
+            (void*)libswdctx, addr, count, (void*)data);
+
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (data==NULL) return LIBSWD_ERROR_NULLPOINTER;
+
+ int i, n, loc, step, res, abort, ctrlstat, single=0;
+ int boundary=libswdctx->log.memap.tarwrap?libswdctx->log.memap.tarwrap:LIBSWD_MEMAP_TARWRAP_MIN;
+
+ // TAR increment for every transfer.
+ switch (libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_SIZE)
+ {
+  case LIBSWD_MEMAP_CSW_SIZE_8BIT:  step=1; break;
+  case LIBSWD_MEMAP_CSW_SIZE_16BIT: step=2; break;
+  case LIBSWD_MEMAP_CSW_SIZE_32BIT: step=4; break;
+  default: return LIBSWD_ERROR_MEMAPACCSIZE;
+ }
+ if ((libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_ADDRINC)==LIBSWD_MEMAP_CSW_ADDRINC_PACKED) step=4;
+
+ libswd_stats_enter(libswdctx, LIBSWD_STATS_CLASS_MEMAP);
+ for (i=0; i<count; i+=n)
+ {
+  loc=addr+i*step;
+  libswdctx->memapresult.addr=loc;
+  n=1;
+  if ((libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_ADDRINC) && !single)
+  {
+   n=(boundary-(loc&(boundary-1)))/step;
+   if (n>count-i) n=count-i;
+  }
+  // Pass address to TAR register.
+  res=libswd_ap_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_TAR_ADDR, &loc);
+  if (res>=0)
+  {
+   // Auto incremented TAR is not tracked.
+   libswdctx->log.memap.tar=(libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_ADDRINC)?LIBSWD_MEMAP_TAR_UNKNOWN:loc;
+   // Read the whole window from the DRW register.
+   res=libswd_ap_read_stream(libswdctx, LIBSWD_MEMAP_DRW_ADDR, &data[i], n);
+  }
+  if (res<0)
+  {
+   if (n>1 && (res==LIBSWD_ERROR_ACK_FAULT || res==LIBSWD_ERROR_PARITY || res==LIBSWD_ERROR_ACKUNKNOWN))
+   {
+    // Replay this window transfer by transfer to find the failing address.
+    abort=0xFFFFFFFE;
+    res=libswd_dap_errors_handle(libswdctx, LIBSWD_OPERATION_EXECUTE, &abort, &ctrlstat);
+    if (res<0) goto libswd_memap_read_block_error;
+    single=n;
+    n=0;
+    continue;
+   }
+   // Clear errors and continue from the failing transfer if policy allows.
+   res=libswd_memap_resume(libswdctx, res, loc);
+   if (res<0) goto libswd_memap_read_block_error;
+   n=0;
+   continue;
+  }
+  if (single) single-=n;
+  libswdctx->log.memap.drw=data[i+n-1];
+  libswdctx->memapresult.done=i+n;
+  // Nested in other MEM-AP call bytes are accounted by the caller.
+  if (libswdctx->statsctl.depth[LIBSWD_STATS_CLASS_MEMAP]==1)
+  {
+   libswdctx->stats.bytes+=n*step;
+   libswd_stats_progress(libswdctx, (i+n)*step, count*step);
+  }
+ }
+ libswdctx->memapresult.addr=addr+count*step;
+ // Resumed faults are only recorded in memapresult.resumes.
+ libswdctx->memapresult.error=LIBSWD_OK;
+ libswd_stats_leave(libswdctx, LIBSWD_STATS_CLASS_MEMAP);
+ return LIBSWD_OK;
+
+libswd_memap_read_block_error:
+ libswdctx->memapresult.error=res;
+ libswd_stats_leave(libswdctx, LIBSWD_STATS_CLASS_MEMAP);
+ return res;
+}
+
+
 /** Generic read using MEM-AP into char array.
  * Data are stored into char array. Count shows CHAR elements.
  * Remember to setup MEM-AP first for valid access!
+ * Bytes past the last whole access are read with byte or halfword access.
  * \param *libswdctx swd context to work on.
  * \param operation can be LIBSWD_OPERATION_ENQUEUE or LIBSWD_OPERATION_EXECUTE.
  * \param addr is the start address of the data to read with MEM-AP.
@@ -208,9 +583,8 @@ int libswd_memap_read_char(libswd_ctx_t *libswdctx, libswd_operation_t operation
  if (operation!=LIBSWD_OPERATION_ENQUEUE && operation!=LIBSWD_OPERATION_EXECUTE)
   return LIBSWD_ERROR_BADOPCODE;
 
- int i, loc, res=0, accsize=0, *memapdrw;
- float tdeltam;
- struct timeval tstart, tstop;
+ int i, n, loc, res=0, accsize=0, step, tail, rest, done, csw, tmp, *drw;
+ libswd_memap_plan_t plan;
 
  // Initialize MEM-AP if necessary.
  if (!libswdctx->log.memap.initialized)
@@ -219,7 +593,7 @@ int libswd_memap_read_char(libswd_ctx_t *libswdctx, libswd_operation_t operation
   if (res<0) goto libswd_memap_read_char_error;
  }
 
- // Verify the count parameter to be access boundary.
+ // Access size is given by the CSW.
  switch (libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_SIZE)
  {
   case LIBSWD_MEMAP_CSW_SIZE_8BIT:
@@ -235,8 +609,6 @@ int libswd_memap_read_char(libswd_ctx_t *libswdctx, libswd_operation_t operation
    res=LIBSWD_ERROR_MEMAPACCSIZE;
    goto libswd_memap_read_char_error;
  }
- if (count%accsize) count=count-(count%accsize);
-
  // Check for alignment issues.
  if ((addr%accsize)!=0)
  {
@@ -244,103 +616,79 @@ int libswd_memap_read_char(libswd_ctx_t *libswdctx, libswd_operation_t operation
   goto libswd_memap_read_char_error;
  }
 
- // Mark start time for transfer speed measurement.
- gettimeofday(&tstart, NULL);
-
- // Perform word-by-word read operation and implode result into char array.
- if (!(libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_ADDRINC))
+ // Bytes past the last whole access are read with smaller access size.
+ rest=count%accsize;
+ count-=rest;
+ res=libswd_memap_plan(addr+count, rest, &plan);
+ if (res<0) goto libswd_memap_read_char_error;
+
+ // Packed transfer returns up to four bytes on every DRW read,
+ // the tail that would read past the end is finished with single transfers.
+ step=accsize;
+ csw=libswdctx->log.memap.csw;
+ if ((csw&LIBSWD_MEMAP_CSW_ADDRINC)==LIBSWD_MEMAP_CSW_ADDRINC_PACKED) step=4;
+ n=count/step;
+ tail=(count%step)/accsize;
+ drw=(int*)malloc((n+tail)*sizeof(int));
+ if (drw==NULL && n+tail)
  {
-  // Use manual TAR incrementation (slower).
-  for (i=0;i<count;i+=accsize)
-  {
-   int tmp;
-   int drw_shift;
-   loc=addr+i;
-   // Calculate the offset in DRW where the data should be
-   // see Data byte-laning in the ARM debug interface v5 documentation
-   // note: this only works for little endian systems.
-   drw_shift=8*(loc%4);
-   // Measure transfer speed.
-   gettimeofday(&tstop, NULL);
-   tdeltam=fabsf((tstop.tv_sec-tstart.tv_sec)*1000+(tstop.tv_usec-tstart.tv_usec)/1000);
-   libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO,
-              "LIBSWD_I: libswd_memap_read_char() reading address 0x%08X (speed %fKB/s)\r",
-              loc, count/tdeltam );
-   fflush(0);
-   // Pass address to TAR register.
-   res=libswd_ap_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_TAR_ADDR, &loc);
-   if (res<0) goto libswd_memap_read_char_error;
-   libswdctx->log.memap.tar=loc;
-   // Read data from DRW register.
-   res=libswd_ap_read(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_DRW_ADDR, &memapdrw);
-   if (res<0) goto libswd_memap_read_char_error;
-   libswdctx->log.memap.drw=*memapdrw;
-   // apply the data byte-laning shift
-   tmp=*memapdrw >>= drw_shift;
-   memcpy((void*)data+i, &tmp, accsize);
-  }
-  libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO, "\n");
+  res=LIBSWD_ERROR_OUTOFMEM;
+  goto libswd_memap_read_char_error;
  }
- else
+ libswdctx->memapresult.count=n+tail+rest/plan.size;
+ libswdctx->memapresult.done=0;
+ libswdctx->memapresult.error=LIBSWD_OK;
+ libswdctx->memapresult.resumes=0;
+
+ // Read raw DRW values with the block engine.
+ res=libswd_memap_read_block(libswdctx, addr, n, drw);
+ if (res>=0 && tail)
  {
-  // Use TAR Auto Increment (faster).
-  // TAR auto increment is only guaranteed to work on the bottom 10 bits
-  // of the TAR register. Above that it is implementation defined.
-  // We use 1024 byte chunks as it will work on every platform
-  // and one TAR write every 1024 bytes is not adding too much overhead.
-  const unsigned int BOUNDARY = 1024;
-  unsigned int i;
-
-  // Check if packed transfer, if so use word access.
-  if (libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_ADDRINC_PACKED) accsize=4;
+  done=libswdctx->memapresult.done;
+  res=libswd_memap_setup(libswdctx, LIBSWD_OPERATION_EXECUTE, (csw&~LIBSWD_MEMAP_CSW_ADDRINC)|LIBSWD_MEMAP_CSW_ADDRINC_SINGLE, libswdctx->log.memap.tar);
+  if (res>=0) res=libswd_memap_read_block(libswdctx, addr+n*step, tail, &drw[n]);
+  libswdctx->memapresult.done+=done;
+  i=libswd_memap_setup(libswdctx, LIBSWD_OPERATION_EXECUTE, csw, libswdctx->log.memap.tar);
+  if (res>=0) res=i;
+ }
+ if (res<0)
+ {
+  free(drw);
+  goto libswd_memap_read_char_error;
+ }
 
-  for (loc = addr, i = 0; loc < (addr + count); loc += accsize, i+= accsize)
-  {
-   int tmp;
-   int drw_shift;
-
-   // Calculate the offset in DRW where the data should be
-   // see Data byte-laning in the ARM debug interface v5 documentation
-   // note: this only works for little endian systems.
-   drw_shift=8*(loc%4);
-
-   // only write the TAR register, if this is the first time through the loop.
-   // or if we've passed over the boundary where TAR auto inc isn't guaranteed
-   // to work anymore.
-   if (loc == addr ||
-       (loc % BOUNDARY) == 0)
-   {
-    // Pass address to TAR register.
-    res=libswd_ap_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_TAR_ADDR, &loc);
-    if (res<0) goto libswd_memap_read_char_error;
-    libswdctx->log.memap.tar=loc;
-   }
+ // Implode result into char array.
+ // Words of aligned transfers hold whole memory words, converted as a block.
+ // Otherwise every byte is found on the DRW lane given by its address,
+ // see Data byte-laning in the ARM debug interface v5 documentation,
+ // this also holds for packed transfers that cross the word boundary.
+ i=0;
+ if (step==4 && !(addr&3))
+ {
+  libswd_memap_drw2image(libswdctx, drw, n, data);
+  i=n*4;
+ }
+ for (; i<count; i++)
+ {
+  loc=addr+i;
+  tmp=(i<n*step)?drw[i/step]:drw[n+(i-n*step)/accsize];
+  data[i]=(char)(((unsigned int)tmp)>>LIBSWD_MEMAP_LANE(libswdctx, loc));
+ }
+ free(drw);
 
-   // Measure transfer speed.
-   gettimeofday(&tstop, NULL);
-   tdeltam=fabsf((tstop.tv_sec-tstart.tv_sec)*1000+(tstop.tv_usec-tstart.tv_usec)/1000);
-   libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO,
-              "LIBSWD_I: libswd_memap_read_char() reading address 0x%08X (speed %fKB/s)\r",
-              loc, count/tdeltam);
-   fflush(0);
-
-   // Read data from the DRW register.
-   res=libswd_ap_read(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_DRW_ADDR, &memapdrw);
-   if (res<0) goto libswd_memap_read_char_error;
-   libswdctx->log.memap.drw=*memapdrw;
-
-   // apply the data byte-laning shift
-   tmp=*memapdrw >>= drw_shift;
-   memcpy((void*)data + i, &tmp, accsize);
-  }
-  libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO, "\n");
+ // Remaining bytes in one batch, that also restores CSW.
+ if (rest)
+ {
+  res=libswd_memap_plan_run(libswdctx, &plan, addr+count, 1, data+count, csw);
+  if (res<0) goto libswd_memap_read_char_error;
+  libswdctx->memapresult.done+=rest/plan.size;
  }
 
  return LIBSWD_OK;
 
 libswd_memap_read_char_error:
  libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR,
-            "\nLIBSWD_E: libswd_memap_read_char(): %s\n",
+            "LIBSWD_E: libswd_memap_read_char(): %s\n",
             libswd_error_string(res) );
  return res;
 }
@@ -367,26 +715,19 @@ int libswd_memap_read_char_csw(libswd_ctx_t *libswdctx, libswd_operation_t opera
  if (operation!=LIBSWD_OPERATION_ENQUEUE && operation!=LIBSWD_OPERATION_EXECUTE)
   return LIBSWD_ERROR_BADOPCODE;
 
- int res=0, accsize=0;
+ int res=0;
 
- // Calculate required access size based on CSW value.
+ // Verify the access size of CSW value.
  switch (csw&LIBSWD_MEMAP_CSW_SIZE)
  {
   case LIBSWD_MEMAP_CSW_SIZE_8BIT:
-   accsize=1;
-   break;
   case LIBSWD_MEMAP_CSW_SIZE_16BIT:
-   accsize=2;
-   break;
   case LIBSWD_MEMAP_CSW_SIZE_32BIT:
-   accsize=4;
    break;
   default:
    res=LIBSWD_ERROR_MEMAPACCSIZE;
    goto libswd_memap_read_char_csw_error;
  }
- // Verify the count parameter to be access boundary.
- if (count%accsize) count=count-(count%accsize);
 
  // Initialize MEM-AP if necessary.
  if (!libswdctx->log.memap.initialized)
@@ -395,8 +736,8 @@ int libswd_memap_read_char_csw(libswd_ctx_t *libswdctx, libswd_operation_t opera
   if (res<0) goto libswd_memap_read_char_csw_error;
  }
 
- // Setup MEM-AP CSW and TAR.
- res=libswd_memap_setup(libswdctx, operation, csw, addr);
+ // Setup MEM-AP CSW, TAR is written by the transfer itself.
+ res=libswd_memap_setup(libswdctx, operation, csw, libswdctx->log.memap.tar);
  if (res<0) goto libswd_memap_read_char_csw_error;
 
  // Perform the read operation.
@@ -407,7 +748,7 @@ int libswd_memap_read_char_csw(libswd_ctx_t *libswdctx, libswd_operation_t opera
 
 libswd_memap_read_char_csw_error:
  libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR,
-            "\nLIBSWD_E: libswd_memap_read_char_csw(): %s\n",
+            "LIBSWD_E: libswd_memap_read_char_csw(): %s\n",
             libswd_error_string(res) );
  return res;
 }
@@ -434,6 +775,10 @@ int libswd_memap_read_char_32(libswd_ctx_t *libswdctx, libswd_operation_t operat
 
 /** Generic read using MEM-AP into int array.
  * Data are stored into int array. Count shows INT elements.
+ * Words are read with libswd_memap_read_block() engine.
+ * Transfer progress (words done, failing address) is stored in
+ * libswdctx->memapresult, faulty words are retried from the failing address
+ * up to config.memapresume times (see libswd_memap_resume()).
  * \param *libswdctx swd context to work on.
  * \param operation can be LIBSWD_OPERATION_ENQUEUE or LIBSWD_OPERATION_EXECUTE.
  * \param addr is the start address of the data to read with MEM-AP.
@@ -451,9 +796,14 @@ int libswd_memap_read_int(libswd_ctx_t *libswdctx, libswd_operation_t operation,
  if (operation!=LIBSWD_OPERATION_ENQUEUE && operation!=LIBSWD_OPERATION_EXECUTE)
   return LIBSWD_ERROR_BADOPCODE;
 
- int i, loc, res, *memapdrw;
- float tdeltam;
- struct timeval tstart, tstop;
+ int res;
+
+ // Prepare transfer result for the caller.
+ libswdctx->memapresult.count=count;
+ libswdctx->memapresult.done=0;
+ libswdctx->memapresult.addr=addr;
+ libswdctx->memapresult.error=LIBSWD_OK;
+ libswdctx->memapresult.resumes=0;
 
  // Initialize MEM-AP if necessary.
  if (!libswdctx->log.memap.initialized)
@@ -462,82 +812,44 @@ int libswd_memap_read_int(libswd_ctx_t *libswdctx, libswd_operation_t operation,
   if (res<0) goto libswd_memap_read_int_error;
  }
 
- // Mark start time for transfer speed measurement.
- gettimeofday(&tstart, NULL);
-
- // Perform word-by-word read operation and store result into int array.
- if (!(libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_ADDRINC))
+ // Serve words from the read cache if the region allows.
+ if ((libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_SIZE)==LIBSWD_MEMAP_CSW_SIZE_32BIT
+     && (count==1 || (libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_ADDRINC)==LIBSWD_MEMAP_CSW_ADDRINC_SINGLE))
  {
-  // Use manual TAR incrementation (slower).
-  for (i=0;i<count;i++)
+  res=libswd_memcache_read(libswdctx, addr, count*4, (char*)data);
+  if (res<0) goto libswd_memap_read_int_error;
+  if (res)
   {
-   loc=addr+i*4;
-   // Measure transfer speed.
-   gettimeofday(&tstop, NULL);
-   tdeltam=fabsf((tstop.tv_sec-tstart.tv_sec)*1000+(tstop.tv_usec-tstart.tv_usec)/1000);
-   libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO,
-              "LIBSWD_I: libswd_memap_read_int() reading address 0x%08X (speed %fKB/s)\r",
-              loc, count*4/tdeltam );
-   fflush(0);
-   // Pass address to TAR register.
-   res=libswd_ap_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_TAR_ADDR, &loc);
-   if (res<0) goto libswd_memap_read_int_error;
-   libswdctx->log.memap.tar=loc;
-   // Read data from DRW register.
-   res=libswd_ap_read(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_DRW_ADDR, &memapdrw);
-   if (res<0) goto libswd_memap_read_int_error;
-   libswdctx->log.memap.drw=*memapdrw;
-   data[i]=*memapdrw;
+   // Cache holds memory image, words are wanted in host byte order.
+   if (libswdctx->log.memap.bswap) libswd_bin_bswap32((char*)data, count);
+   libswdctx->memapresult.done=count;
+   libswdctx->memapresult.addr=addr+count*4;
+   return LIBSWD_OK;
   }
-  libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO, "\n");
  }
- else
- {
-  // Use TAR Auto Increment (faster).
-  // TAR auto increment is only guaranteed to work on the bottom 10 bits
-  // of the TAR register. Above that it is implementation defined.
-  // We use 1024 byte chunks as it will work on every platform
-  // and one TAR write every 1024 bytes is not adding too much overhead.
-  const unsigned int BOUNDARY = 1024;
-  unsigned int i;
 
-  for (loc = addr, i = 0; loc < (addr + (count * 4)); loc += 4, i++)
-  {
-   // only write the TAR register, if this is the first time through the loop.
-   // or if we've passed over the boundary where TAR auto inc isn't guaranteed
-   // to work anymore.
-   if (loc == addr ||
-       (loc % BOUNDARY) == 0)
-   {
-    // Pass address to TAR register.
-    res=libswd_ap_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_TAR_ADDR, &loc);
-    if (res<0) goto libswd_memap_read_int_error;
-    libswdctx->log.memap.tar=loc;
-   }
-
-   // Measure transfer speed.
-   gettimeofday(&tstop, NULL);
-   tdeltam=fabsf((tstop.tv_sec-tstart.tv_sec)*1000+(tstop.tv_usec-tstart.tv_usec)/1000);
-   libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO,
-              "LIBSWD_I: libswd_memap_read_int() reading address 0x%08X (speed %fKB/s)\r",
-              loc, count*4/tdeltam );
-   fflush(0);
-
-   // Read data from the DRW register.
-   res=libswd_ap_read(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_DRW_ADDR, &memapdrw);
-   if (res<0) goto libswd_memap_read_int_error;
-   libswdctx->log.memap.drw=*memapdrw;
-   data[i]=*memapdrw;
-  }
-  libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO, "\n");
+ // Single word goes through Banked Data registers, saving the TAR write
+ // when previous access was within the same 16-byte window.
+ if (count==1 && !(addr&3) && (libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_SIZE)==LIBSWD_MEMAP_CSW_SIZE_32BIT)
+ {
+  res=libswd_memap_bd(libswdctx, 1, addr, data);
+  if (res<0) goto libswd_memap_read_int_error;
+  libswdctx->memapresult.done=1;
+  return LIBSWD_OK;
  }
 
+ // Words go straight into the caller's buffer.
+ res=libswd_memap_read_block(libswdctx, addr, count, data);
+ if (res<0) goto libswd_memap_read_int_error;
+
  return LIBSWD_OK;
 
 libswd_memap_read_int_error:
+ libswdctx->memapresult.error=res;
  libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR,
-            "\nLIBSWD_E: libswd_memap_read_int(): %s\n",
-            libswd_error_string(res) );
+            "LIBSWD_E: libswd_memap_read_int(): %s at 0x%08X after %d of %d words\n",
+            libswd_error_string(res), libswdctx->memapresult.addr,
+            libswdctx->memapresult.done, count );
  return res;
 }
 
@@ -583,8 +895,8 @@ int libswd_memap_read_int_csw(libswd_ctx_t *libswdctx, libswd_operation_t operat
   if (res<0) goto libswd_memap_read_int_csw_error;
  }
 
- // Setup MEM-AP CSW and TAR.
- res=libswd_memap_setup(libswdctx, operation, csw, addr);
+ // Setup MEM-AP CSW, TAR is written by the transfer itself.
+ res=libswd_memap_setup(libswdctx, operation, csw, libswdctx->log.memap.tar);
  if (res<0) goto libswd_memap_read_int_csw_error;
 
  // Perform the read operation.
@@ -595,7 +907,7 @@ int libswd_memap_read_int_csw(libswd_ctx_t *libswdctx, libswd_operation_t operat
 
 libswd_memap_read_int_csw_error:
  libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR,
-            "\nLIBSWD_E: libswd_memap_read_int_csw(): %s\n",
+            "LIBSWD_E: libswd_memap_read_int_csw(): %s\n",
             libswd_error_string(res) );
  return res;
 }
@@ -621,8 +933,129 @@ int libswd_memap_read_int_32(libswd_ctx_t *libswdctx, libswd_operation_t operati
 }
 
 
+/** Pipelined MEM-AP block write engine, writes count DRW transfers at addr.
+ * TAR is written once per auto increment window (see libswd_memap_tarwrap()),
+ * by default 1024 bytes guaranteed by ADIv5, and the whole
+ * window is written with back-to-back DRW writes in one queue flush, then
+ * validated once with CTRL/STAT (see libswd_ap_write_stream()).
+ * Without TAR auto increment each transfer is a window of its own.
+ * When a window fails, transfers completed before the failing one are kept
+ * and libswd_memap_resume() policy applies to the failing address, so no
+ * word is ever written twice (FIFOs, write-to-clear registers, flash).
+ * Progress is stored in libswdctx->memapresult (done transfers, address).
+ * Transfer i writes data[i*stride], stride 0 fills memory with one value.
+ * Remember to setup CSW first for valid bus access!
+ * \param *libswdctx swd context to work on.
+ * \param addr is the start address of the data to write with MEM-AP.
+ * \param count is the number of DRW transfers to perform.
+ * \param *data is the pointer to int array with raw DRW values to write.
+ * \param stride is the data array step between transfers [words].
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_memap_write_block_stride(libswd_ctx_t *libswdctx, int addr, int count, int *data, int stride){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG,
+            "LIBSWD_D: Entering libswd_memap_write_block(*libswdctx=%p, addr=0x%08X, count=0x%08X, *data=%p, stride=%d)...\n",
+            (void*)libswdctx, addr, count, (void*)data, stride);
+
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (data==NULL) return LIBSWD_ERROR_NULLPOINTER;
+ if (stride<0) return LIBSWD_ERROR_PARAM;
+
+ int i, n, loc, step, res, done, *tar;
+ int boundary=libswdctx->log.memap.tarwrap?libswdctx->log.memap.tarwrap:LIBSWD_MEMAP_TARWRAP_MIN;
+
+ // TAR increment for every transfer.
+ switch (libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_SIZE)
+ {
+  case LIBSWD_MEMAP_CSW_SIZE_8BIT:  step=1; break;
+  case LIBSWD_MEMAP_CSW_SIZE_16BIT: step=2; break;
+  case LIBSWD_MEMAP_CSW_SIZE_32BIT: step=4; break;
+  default: return LIBSWD_ERROR_MEMAPACCSIZE;
+ }
+ if ((libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_ADDRINC)==LIBSWD_MEMAP_CSW_ADDRINC_PACKED) step=4;
+
+ // Cached copy of the range gets stale.
+ libswd_memcache_invalidate(libswdctx, addr, (libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_ADDRINC)?count*step:step);
+
+ libswd_stats_enter(libswdctx, LIBSWD_STATS_CLASS_MEMAP);
+ for (i=0; i<count; i+=n)
+ {
+  loc=addr+i*step;
+  libswdctx->memapresult.addr=loc;
+  n=1;
+  if (libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_ADDRINC)
+  {
+   n=(boundary-(loc&(boundary-1)))/step;
+   if (n>count-i) n=count-i;
+  }
+  // Pass address to TAR register.
+  done=0;
+  res=libswd_ap_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_TAR_ADDR, &loc);
+  if (res>=0)
+  {
+   // Auto incremented TAR is not tracked.
+   libswdctx->log.memap.tar=(libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_ADDRINC)?LIBSWD_MEMAP_TAR_UNKNOWN:loc;
+   // Write the whole window to the DRW register.
+   res=libswd_ap_stream_stride(libswdctx, 0, LIBSWD_MEMAP_DRW_ADDR, &data[i*stride], n, stride);
+   done=(res<0)?libswdctx->stream.done:n;
+   // Write is acknowledged before it reaches the bus, so its fault shows
+   // on later ACKs, then TAR that stopped incrementing holds the failing address.
+   if (res<0 && done && (libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_ADDRINC))
+   {
+    if (libswd_ap_read(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_TAR_ADDR, &tar)>=0
+        && (unsigned int)(*tar-loc)<(unsigned int)(done*step))
+     done=(*tar-loc)/step;
+   }
+  }
+  if (done)
+  {
+   libswdctx->log.memap.drw=data[(i+done-1)*stride];
+   libswdctx->memapresult.done=i+done;
+   // Nested in other MEM-AP call bytes are accounted by the caller.
+   if (libswdctx->statsctl.depth[LIBSWD_STATS_CLASS_MEMAP]==1)
+   {
+    libswdctx->stats.bytes+=done*step;
+    libswd_stats_progress(libswdctx, (i+done)*step, count*step);
+   }
+  }
+  if (res<0)
+  {
+   // Acknowledged words were accepted, continue from the failing transfer
+   // if policy allows.
+   res=libswd_memap_resume(libswdctx, res, loc+done*step);
+   if (res<0) goto libswd_memap_write_block_error;
+  }
+  n=done;
+ }
+ libswdctx->memapresult.addr=addr+count*step;
+ // Resumed faults are only recorded in memapresult.resumes.
+ libswdctx->memapresult.error=LIBSWD_OK;
+ libswd_stats_leave(libswdctx, LIBSWD_STATS_CLASS_MEMAP);
+ return LIBSWD_OK;
+
+libswd_memap_write_block_error:
+ libswdctx->memapresult.error=res;
+ libswd_stats_leave(libswdctx, LIBSWD_STATS_CLASS_MEMAP);
+ return res;
+}
+
+
+/** Macro function: Pipelined MEM-AP block write engine for int array.
+ * See libswd_memap_write_block_stride(), data array is used word by word.
+ * \param *libswdctx swd context to work on.
+ * \param addr is the start address of the data to write with MEM-AP.
+ * \param count is the number of DRW transfers to perform.
+ * \param *data is the pointer to int array with raw DRW values to write.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_memap_write_block(libswd_ctx_t *libswdctx, int addr, int count, int *data){
+ return libswd_memap_write_block_stride(libswdctx, addr, count, data, 1);
+}
+
+
 /** Generic write using MEM-AP from char array.
  * Data are read from char array. Count shows CHAR elements.
+ * Bytes past the last whole access are written with byte or halfword access.
  * \param *libswdctx swd context to work on.
  * \param operation can be LIBSWD_OPERATION_ENQUEUE or LIBSWD_OPERATION_EXECUTE.
  * \param addr is the start address of the data to write with MEM-AP.
@@ -640,9 +1073,8 @@ int libswd_memap_write_char(libswd_ctx_t *libswdctx, libswd_operation_t operatio
  if (operation!=LIBSWD_OPERATION_ENQUEUE && operation!=LIBSWD_OPERATION_EXECUTE)
   return LIBSWD_ERROR_BADOPCODE;
 
- int i, loc, res=0, accsize=0;
- float tdeltam;
- struct timeval tstart, tstop;
+ int i, n, loc, res=0, accsize=0, step, tail, rest, done, csw, *drw;
+ libswd_memap_plan_t plan;
 
  // Initialize MEM-AP if neessary.
  if (!libswdctx->log.memap.initialized)
@@ -651,7 +1083,7 @@ int libswd_memap_write_char(libswd_ctx_t *libswdctx, libswd_operation_t operatio
   if (res<0) goto libswd_memap_write_char_error;
  }
 
- // Verify the count parameter to be access boundary.
+ // Access size is given by the CSW.
  switch (libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_SIZE)
  {
   case LIBSWD_MEMAP_CSW_SIZE_8BIT:
@@ -667,8 +1099,6 @@ int libswd_memap_write_char(libswd_ctx_t *libswdctx, libswd_operation_t operatio
    res=LIBSWD_ERROR_MEMAPACCSIZE;
    goto libswd_memap_write_char_error;
  }
- if (count%accsize) count=count-(count%accsize);
-
  // check for alignment issues.
  if ((addr%accsize)!=0)
  {
@@ -676,90 +1106,87 @@ int libswd_memap_write_char(libswd_ctx_t *libswdctx, libswd_operation_t operatio
   goto libswd_memap_write_char_error;
  }
 
- // Mark start time for transfer speed measurement.
- gettimeofday(&tstart, NULL);
-
- // Perform word-by-word write operation from char array.
- // Use write method that match the CSW AddrInc configuration.
- if (!(libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_ADDRINC))
+ // Bytes past the last whole access are written with smaller access size.
+ rest=count%accsize;
+ count-=rest;
+ res=libswd_memap_plan(addr+count, rest, &plan);
+ if (res<0) goto libswd_memap_write_char_error;
+
+ // Packed transfer writes whole word on every DRW write.
+ step=accsize;
+ csw=libswdctx->log.memap.csw;
+ if ((csw&LIBSWD_MEMAP_CSW_ADDRINC)==LIBSWD_MEMAP_CSW_ADDRINC_PACKED) step=4;
+ n=count/step;
+ tail=(count%step)/accsize;
+ libswdctx->memapresult.count=n+tail+rest/plan.size;
+ libswdctx->memapresult.done=0;
+ libswdctx->memapresult.error=LIBSWD_OK;
+ libswdctx->memapresult.resumes=0;
+
+ // Whole words from aligned buffer go to the engine as they are when host
+ // and target byte order match, otherwise explode data into DRW values.
+ if (step==4 && (addr&3)==0 && ((unsigned long)data%sizeof(int))==0 && !libswdctx->log.memap.bswap)
+ {
+  drw=(int*)data;
+ }
+ else
  {
-  // Use manual TAR incrementation (slower).
-  for (i=0;i<count;i+=accsize)
+  drw=(int*)malloc((n+tail)*sizeof(int));
+  if (drw==NULL && n+tail)
+  {
+   res=LIBSWD_ERROR_OUTOFMEM;
+   goto libswd_memap_write_char_error;
+  }
+  memset((void*)drw, 0, (n+tail)*sizeof(int));
+  // Aligned words are converted as a block, otherwise every byte goes
+  // to the DRW lane given by its address, see Data byte-laning in the ARM
+  // debug interface v5 documentation, this also holds for packed
+  // transfers that cross the word boundary.
+  if (step==4 && (addr&3)==0) libswd_memap_image2drw(libswdctx, data, n, drw);
+  else for (i=0; i<n*step; i++)
   {
-   int drw_shift;
    loc=addr+i;
-   // Calculate the offset in DRW where the data should go
-   // see Data byte-laning in the ARM debug interface v5 documentation
-   // note: this only works for little endian systems.
-   drw_shift=8*(loc%4);
-   // Measure transfer speed.
-   gettimeofday(&tstop, NULL);
-   tdeltam=fabsf((tstop.tv_sec-tstart.tv_sec)*1000+(tstop.tv_usec-tstart.tv_usec)/1000);
-   libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO,
-              "LIBSWD_I: libswd_memap_write_char() writing address 0x%08X (speed %fKB/s)\r",
-              loc, count/tdeltam );
-   fflush(0);
-   // Pass address to TAR register.
-   res=libswd_ap_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_TAR_ADDR, &loc);
-   if (res<0) goto libswd_memap_write_char_error;
-   libswdctx->log.memap.tar=loc;
-   // Implode and Write data to DRW register.
-   memcpy((void*)&libswdctx->log.memap.drw, data+i, accsize);
-   // apply the data byte-laning shift
-   libswdctx->log.memap.drw <<= drw_shift;
-   res=libswd_ap_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_DRW_ADDR, &libswdctx->log.memap.drw);
-   if (res<0) goto libswd_memap_write_char_error;
+   drw[i/step]|=((unsigned int)(unsigned char)data[i])<<LIBSWD_MEMAP_LANE(libswdctx, loc);
   }
  }
- else
- {
-  // Use TAR Auto Increment (faster).
-  // TAR auto increment is only guaranteed to work on the bottom 10 bits
-  // of the TAR register. Above that it is implementation defined.
-  // We use 1024 byte chunks as it will work on every platform
-  // and one TAR write every 1024 bytes is not adding too much overhead.
-  const unsigned int BOUNDARY = 1024;
-  unsigned int i;
+ res=libswd_memap_write_block(libswdctx, addr, n, drw);
+ if (res<0) goto libswd_memap_write_char_tail;
 
-  // Check if packed transfer, if so use word access.
-  if (libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_ADDRINC_PACKED) accsize=4;
-
-  for (loc = addr, i = 0; loc < (addr + count); loc += accsize, i+= accsize)
+ // Packed transfer would write past the end, finish the tail with single transfers.
+ if (tail)
+ {
+  loc=addr+n*step;
+  if (drw==(int*)data)
   {
-   int drw_shift;
-
-   // Calculate the offset in DRW where the data should go
-   // see Data byte-laning in the ARM debug interface v5 documentation
-   // note: this only works for little endian systems.
-   drw_shift=8*(loc%4);
-
-   // only write the TAR register, if this is the first time through the loop.
-   // or if we've passed over the boundary where TAR auto inc isn't guaranteed
-   // to work anymore.
-   if (loc == addr ||
-       (loc % BOUNDARY) == 0)
+   drw=(int*)malloc(tail*sizeof(int));
+   if (drw==NULL)
    {
-    // Pass address to TAR register.
-    res=libswd_ap_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_TAR_ADDR, &loc);
-    if (res<0) goto libswd_memap_write_char_error;
-    libswdctx->log.memap.tar=loc;
+    res=LIBSWD_ERROR_OUTOFMEM;
+    goto libswd_memap_write_char_error;
    }
-
-   // Measure transfer speed.
-   gettimeofday(&tstop, NULL);
-   tdeltam=fabsf((tstop.tv_sec-tstart.tv_sec)*1000+(tstop.tv_usec-tstart.tv_usec)/1000);
-   libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO,
-              "LIBSWD_I: libswd_memap_write_char() writing address 0x%08X (speed %fKB/s)\r",
-              loc, count/tdeltam );
-   fflush(0);
-
-   // apply the data byte-laning shift and write to the DRW register
-   memcpy((void*)&libswdctx->log.memap.drw, data + i, accsize);
-   libswdctx->log.memap.drw <<= drw_shift;
-   res=libswd_ap_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_DRW_ADDR, &libswdctx->log.memap.drw);
-   if (res<0) goto libswd_memap_write_char_error;
+   n=0;
   }
-  libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO, "\n");
+  memset((void*)&drw[n], 0, tail*sizeof(int));
+  for (i=0; i<tail*accsize; i++)
+   drw[n+i/accsize]|=((unsigned int)(unsigned char)data[(loc-addr)+i])<<LIBSWD_MEMAP_LANE(libswdctx, loc+i);
+  done=libswdctx->memapresult.done;
+  res=libswd_memap_setup(libswdctx, LIBSWD_OPERATION_EXECUTE, (csw&~LIBSWD_MEMAP_CSW_ADDRINC)|LIBSWD_MEMAP_CSW_ADDRINC_SINGLE, libswdctx->log.memap.tar);
+  if (res>=0) res=libswd_memap_write_block(libswdctx, loc, tail, &drw[n]);
+  libswdctx->memapresult.done+=done;
+  i=libswd_memap_setup(libswdctx, LIBSWD_OPERATION_EXECUTE, csw, libswdctx->log.memap.tar);
+  if (res>=0) res=i;
+ }
+
+libswd_memap_write_char_tail:
+ if (drw!=(int*)data) free(drw);
+ if (res<0) goto libswd_memap_write_char_error;
+
+ // Remaining bytes in one batch, that also restores CSW.
+ if (rest)
+ {
+  res=libswd_memap_plan_run(libswdctx, &plan, addr+count, 0, data+count, csw);
+  if (res<0) goto libswd_memap_write_char_error;
+  libswdctx->memapresult.done+=rest/plan.size;
  }
 
  return LIBSWD_OK;
@@ -790,26 +1217,19 @@ int libswd_memap_write_char_csw(libswd_ctx_t *libswdctx, libswd_operation_t oper
  if (operation!=LIBSWD_OPERATION_ENQUEUE && operation!=LIBSWD_OPERATION_EXECUTE)
   return LIBSWD_ERROR_BADOPCODE;
 
- int res=0, accsize=0;
+ int res=0;
 
- // Calculate required access size based on CSW value.
+ // Verify the access size of CSW value.
  switch (csw&LIBSWD_MEMAP_CSW_SIZE)
  {
   case LIBSWD_MEMAP_CSW_SIZE_8BIT:
-   accsize=1;
-   break;
   case LIBSWD_MEMAP_CSW_SIZE_16BIT:
-   accsize=2;
-   break;
   case LIBSWD_MEMAP_CSW_SIZE_32BIT:
-   accsize=4;
    break;
   default:
    res=LIBSWD_ERROR_MEMAPACCSIZE;
    goto libswd_memap_write_char_csw_error;
  }
- // Verify the count parameter to be access boundary.
- if (count%accsize) count=count-(count%accsize);
 
  // Initialize MEM-AP if necessary.
  if (!libswdctx->log.memap.initialized)
@@ -818,8 +1238,8 @@ int libswd_memap_write_char_csw(libswd_ctx_t *libswdctx, libswd_operation_t oper
   if (res<0) goto libswd_memap_write_char_csw_error;
  }
 
- // Setup MEM-AP CSW and TAR.
- res=libswd_memap_setup(libswdctx, operation, csw, addr);
+ // Setup MEM-AP CSW, TAR is written by the transfer itself.
+ res=libswd_memap_setup(libswdctx, operation, csw, libswdctx->log.memap.tar);
  if (res<0) goto libswd_memap_write_char_csw_error;
 
  res=libswd_memap_write_char(libswdctx, operation, addr, count, data);
@@ -856,6 +1276,10 @@ int libswd_memap_write_char_32(libswd_ctx_t *libswdctx, libswd_operation_t opera
 /** Generic write using MEM-AP from int array.
  * Data are stored into char array.
  * Remember to setup CSW first for valid bus access!
+ * Words are written with libswd_memap_write_block() engine.
+ * Transfer progress (words done, failing address) is stored in
+ * libswdctx->memapresult, faulty words are retried from the failing address
+ * up to config.memapresume times (see libswd_memap_resume()).
  * \param *libswdctx swd context to work on.
  * \param operation can be LIBSWD_OPERATION_ENQUEUE or LIBSWD_OPERATION_EXECUTE.
  * \param addr is the start address of the data to write with MEM-AP.
@@ -873,9 +1297,14 @@ int libswd_memap_write_int(libswd_ctx_t *libswdctx, libswd_operation_t operation
  if (operation!=LIBSWD_OPERATION_ENQUEUE && operation!=LIBSWD_OPERATION_EXECUTE)
   return LIBSWD_ERROR_BADOPCODE;
 
- int i, loc, res=0;
- float tdeltam;
- struct timeval tstart, tstop;
+ int res=0;
+
+ // Prepare transfer result for the caller.
+ libswdctx->memapresult.count=count;
+ libswdctx->memapresult.done=0;
+ libswdctx->memapresult.addr=addr;
+ libswdctx->memapresult.error=LIBSWD_OK;
+ libswdctx->memapresult.resumes=0;
 
  // Initialize MEM-AP if necessary.
  if (!libswdctx->log.memap.initialized)
@@ -884,80 +1313,28 @@ int libswd_memap_write_int(libswd_ctx_t *libswdctx, libswd_operation_t operation
   if (res<0) goto libswd_memap_write_int_error;
  }
 
- // Mark start time for transfer speed measurement.
- gettimeofday(&tstart, NULL);
-
- // Perform word-by-word write operation from int array.
- if (!(libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_ADDRINC))
+ // Single word goes through Banked Data registers, saving the TAR write
+ // when previous access was within the same 16-byte window.
+ if (count==1 && !(addr&3) && (libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_SIZE)==LIBSWD_MEMAP_CSW_SIZE_32BIT)
  {
-  // Use manual TAR incrementation (slower).
-  for (i=0;i<count;i++)
-  {
-   loc=addr+i*4;
-   // Measure transfer speed.
-   gettimeofday(&tstop, NULL);
-   tdeltam=fabsf((tstop.tv_sec-tstart.tv_sec)*1000+(tstop.tv_usec-tstart.tv_usec)/1000);
-   libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO,
-              "LIBSWD_I: libswd_memap_write_int() writing address 0x%08X (speed %fKB/s)\r",
-              loc, count*4/tdeltam );
-   fflush(0);
-   // Pass address to TAR register.
-   res=libswd_ap_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_TAR_ADDR, &loc);
-   if (res<0) goto libswd_memap_write_int_error;
-   libswdctx->log.memap.tar=loc;
-   // Implode and Write data to DRW register.
-   res=libswd_ap_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_DRW_ADDR, data+i);
-   if (res<0) goto libswd_memap_write_int_error;
-   libswdctx->log.memap.drw=data[i];
-  }
-  libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO, "\n");
+  res=libswd_memap_bd(libswdctx, 0, addr, data);
+  if (res<0) goto libswd_memap_write_int_error;
+  libswdctx->memapresult.done=1;
+  return LIBSWD_OK;
  }
- else
- {
-  // Use TAR Auto Increment (faster).
-  // TAR auto increment is only guaranteed to work on the bottom 10 bits
-  // of the TAR register. Above that it is implementation defined.
-  // We use 1024 byte chunks as it will work on every platform
-  // and one TAR write every 1024 bytes is not adding too much overhead.
-  const unsigned int BOUNDARY = 1024;
-  unsigned int i;
-
-  for (loc = addr, i = 0; loc < (addr + (count * 4)); loc += 4, i++)
-  {
-   // only write the TAR register, if this is the first time through the loop.
-   // or if we've passed over the boundary where TAR auto inc isn't guaranteed
-   // to work anymore.
-   if (loc == addr ||
-       (loc % BOUNDARY) == 0)
-   {
-    // Pass address to TAR register.
-    res=libswd_ap_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_TAR_ADDR, &loc);
-    if (res<0) goto libswd_memap_write_int_error;
-    libswdctx->log.memap.tar=loc;
-   }
 
-   // Measure transfer speed.
-   gettimeofday(&tstop, NULL);
-   tdeltam=fabsf((tstop.tv_sec-tstart.tv_sec)*1000+(tstop.tv_usec-tstart.tv_usec)/1000);
-   libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO,
-              "LIBSWD_I: libswd_memap_write_int() writing address 0x%08X (speed %fKB/s)\r",
-              loc, count*4/tdeltam );
-   fflush(0);
-
-   // Write data to DRW register.
-   libswdctx->log.memap.drw=data[i];
-   res=libswd_ap_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_DRW_ADDR, &libswdctx->log.memap.drw);
-   if (res<0) goto libswd_memap_write_int_error;
-  }
-  libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO, "\n");
- }
+ // Words go straight from the caller's buffer.
+ res=libswd_memap_write_block(libswdctx, addr, count, data);
+ if (res<0) goto libswd_memap_write_int_error;
 
  return LIBSWD_OK;
 
 libswd_memap_write_int_error:
+ libswdctx->memapresult.error=res;
  libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR,
-            "\nLIBSWD_E: libswd_memap_write_int(): %s\n",
-            libswd_error_string(res) );
+            "LIBSWD_E: libswd_memap_write_int(): %s at 0x%08X after %d of %d words\n",
+            libswd_error_string(res), libswdctx->memapresult.addr,
+            libswdctx->memapresult.done, count );
  return res;
 }
 
@@ -1001,8 +1378,8 @@ int libswd_memap_write_int_csw(libswd_ctx_t *libswdctx, libswd_operation_t opera
   if (res<0) goto libswd_memap_write_int_csw_error;
  }
 
- // Setup MEM-AP CSW and TAR.
- res=libswd_memap_setup(libswdctx, operation, csw, addr);
+ // Setup MEM-AP CSW, TAR is written by the transfer itself.
+ res=libswd_memap_setup(libswdctx, operation, csw, libswdctx->log.memap.tar);
  if (res<0) goto libswd_memap_write_int_csw_error;
 
  // Perform the write operation.
@@ -1013,7 +1390,7 @@ int libswd_memap_write_int_csw(libswd_ctx_t *libswdctx, libswd_operation_t opera
 
 libswd_memap_write_int_csw_error:
  libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR,
-            "\nLIBSWD_E: libswd_memap_write_int_csw(): %s\n",
+            "LIBSWD_E: libswd_memap_write_int_csw(): %s\n",
             libswd_error_string(res) );
  return res;
 }
@@ -1036,4 +1413,1447 @@ int libswd_memap_write_int_32(libswd_ctx_t *libswdctx, libswd_operation_t operat
 }
 
 
+/** Convert target memory image into DRW values of 32-bit transfers.
+ * Image bytes are in target memory order, DRW values in host byte order,
+ * so the whole block is byte swapped at once when these orders differ.
+ * \param *libswdctx swd context to work on.
+ * \param *image is the memory image of count words.
+ * \param count is the number of words.
+ * \param *drw will hold count DRW values.
+ * \return number of words converted or LIBSWD_ERROR code on failure.
+ */
+int libswd_memap_image2drw(libswd_ctx_t *libswdctx, const char *image, int count, int *drw){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (image==NULL || drw==NULL) return LIBSWD_ERROR_NULLPOINTER;
+ if (count<0) return LIBSWD_ERROR_PARAM;
+ if ((const char*)drw!=image) memcpy((void*)drw, (void*)image, count*sizeof(int));
+ if (libswdctx->log.memap.bswap) libswd_bin_bswap32((char*)drw, count);
+ return count;
+}
+
+/** Convert DRW values of 32-bit transfers into target memory image.
+ * Reverse of libswd_memap_image2drw(), conversion may be done in place.
+ * \param *libswdctx swd context to work on.
+ * \param *drw is the array of count DRW values.
+ * \param count is the number of words.
+ * \param *image will hold the memory image of count words.
+ * \return number of words converted or LIBSWD_ERROR code on failure.
+ */
+int libswd_memap_drw2image(libswd_ctx_t *libswdctx, int *drw, int count, char *image){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (image==NULL || drw==NULL) return LIBSWD_ERROR_NULLPOINTER;
+ if (count<0) return LIBSWD_ERROR_PARAM;
+ if ((char*)drw!=image) memcpy((void*)image, (void*)drw, count*sizeof(int));
+ if (libswdctx->log.memap.bswap) libswd_bin_bswap32(image, count);
+ return count;
+}
+
+
+/** Plan MEM-AP access of any address and length.
+ * Region is split into unaligned head, whole words of the aligned bulk and
+ * the unaligned tail. Head and tail share one access size (halfword when
+ * possible, byte otherwise), so one CSW switch is enough for both of them.
+ * \param addr is the start address of the region.
+ * \param count is the number of bytes in the region.
+ * \param *plan is the pointer to the plan to be filled in.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_memap_plan(int addr, int count, libswd_memap_plan_t *plan){
+ if (plan==NULL) return LIBSWD_ERROR_NULLPOINTER;
+ if (count<0) return LIBSWD_ERROR_PARAM;
+ plan->head=(4-(addr&3))&3;
+ if (plan->head>count) plan->head=count;
+ plan->bulk=(count-plan->head)/4;
+ plan->tail=count-plan->head-plan->bulk*4;
+ plan->size=((addr|count)&1)?1:2;
+ return LIBSWD_OK;
+}
+
+
+/** Transfer head and tail of the access plan in a single batch.
+ * CSW is switched to the plan access size, head and tail are transferred
+ * with byte-laning and CSW is restored, all with one libswd_transfer().
+ * \param *libswdctx swd context to work on.
+ * \param *plan is the access plan made by libswd_memap_plan().
+ * \param addr is the start address of the planned region.
+ * \param RnW is 1 for read, 0 for write.
+ * \param *data is the pointer to the whole region data.
+ * \param csw is the CSW value to leave in the MEM-AP.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_memap_plan_run(libswd_ctx_t *libswdctx, libswd_memap_plan_t *plan, int addr, char RnW, char *data, int csw){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG,
+            "LIBSWD_D: Entering libswd_memap_plan_run(*libswdctx=%p, *plan=%p, addr=0x%08X, RnW=%d, *data=%p, csw=0x%08X)...\n",
+            (void*)libswdctx, (void*)plan, addr, RnW, (void*)data, csw );
+
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (plan==NULL || data==NULL) return LIBSWD_ERROR_NULLPOINTER;
+
+ libswd_xfer_t list[LIBSWD_MEMAP_PLAN_XFERS];
+ int i, j, k, n, loc, len, res, failed, first[2], *memaptar;
+
+ // Nothing unaligned, just bring back the CSW.
+ if (!plan->head && !plan->tail)
+  return libswd_memap_setup(libswdctx, LIBSWD_OPERATION_EXECUTE, csw, libswdctx->log.memap.tar);
+
+ if (!RnW) libswd_memcache_invalidate(libswdctx, addr, plan->head+plan->bulk*4+plan->tail);
+ memset((void*)list, 0, sizeof(list));
+ n=0;
+ list[n].APnDP=1;
+ list[n].addr=LIBSWD_MEMAP_CSW_ADDR;
+ list[n].value=(libswdctx->log.memap.csw&~(LIBSWD_MEMAP_CSW_SIZE|LIBSWD_MEMAP_CSW_ADDRINC));
+ list[n].value|=(plan->size==2)?LIBSWD_MEMAP_CSW_SIZE_16BIT:LIBSWD_MEMAP_CSW_SIZE_8BIT;
+ list[n++].value|=LIBSWD_MEMAP_CSW_ADDRINC_SINGLE|LIBSWD_MEMAP_CSW_DBGSWENABLE|LIBSWD_MEMAP_CSW_PROT;
+ for (j=0; j<2; j++)
+ {
+  loc=j?addr+plan->head+plan->bulk*4:addr;
+  len=j?plan->tail:plan->head;
+  if (!len) continue;
+  list[n].APnDP=1;
+  list[n].addr=LIBSWD_MEMAP_TAR_ADDR;
+  list[n++].value=loc;
+  first[j]=n;
+  for (i=0; i<len; i+=plan->size, n++)
+  {
+   list[n].APnDP=1;
+   list[n].RnW=RnW;
+   list[n].addr=LIBSWD_MEMAP_DRW_ADDR;
+   // Every byte goes to the DRW lane given by its address.
+   if (!RnW)
+    for (k=0; k<plan->size; k++)
+     list[n].value|=((unsigned int)(unsigned char)data[loc-addr+i+k])<<LIBSWD_MEMAP_LANE(libswdctx, loc+i+k);
+  }
+ }
+ list[n].APnDP=1;
+ list[n].addr=LIBSWD_MEMAP_CSW_ADDR;
+ list[n++].value=csw;
+ list[n].APnDP=1;
+ list[n].RnW=1;
+ list[n++].addr=LIBSWD_MEMAP_TAR_ADDR;
+
+ libswd_stats_enter(libswdctx, LIBSWD_STATS_CLASS_MEMAP);
+ res=libswd_transfer(libswdctx, list, n, &failed);
+ libswd_stats_leave(libswdctx, LIBSWD_STATS_CLASS_MEMAP);
+ if (res<0)
+ {
+  // Put back the CSW and TAR cache in sync with the target.
+  if (libswd_ap_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_CSW_ADDR, &csw)<0
+      || libswd_ap_read(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_TAR_ADDR, &memaptar)<0)
+   libswdctx->log.memap.initialized=0;
+  else libswdctx->log.memap.tar=*memaptar;
+  libswdctx->log.memap.csw=csw;
+  goto libswd_memap_plan_run_error;
+ }
+ libswdctx->log.memap.csw=csw;
+ libswdctx->log.memap.tar=list[n-1].value;
+ if (!libswdctx->statsctl.depth[LIBSWD_STATS_CLASS_MEMAP]) libswdctx->stats.bytes+=plan->head+plan->tail;
+
+ // Implode read data from byte lanes.
+ if (RnW)
+ {
+  for (j=0; j<2; j++)
+  {
+   loc=j?addr+plan->head+plan->bulk*4:addr;
+   len=j?plan->tail:plan->head;
+   for (i=0, n=first[j]; i<len; i+=plan->size, n++)
+    for (k=0; k<plan->size; k++)
+     data[loc-addr+i+k]=(char)(((unsigned int)list[n].value)>>LIBSWD_MEMAP_LANE(libswdctx, loc+i+k));
+  }
+ }
+
+ return LIBSWD_OK;
+
+libswd_memap_plan_run_error:
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR,
+            "LIBSWD_E: libswd_memap_plan_run(): %s\n",
+            libswd_error_string(res) );
+ return res;
+}
+
+
+/** Read any number of bytes from any address using MEM-AP.
+ * Region is planned with libswd_memap_plan(), aligned bulk is read with
+ * 32-bit auto increment and unaligned head and tail in one batch after it.
+ * CSW is left as it was before the call.
+ * \param *libswdctx swd context to work on.
+ * \param addr is the start address of the data to read with MEM-AP.
+ * \param count is the number of bytes to read.
+ * \param *data is the pointer to char array where result will be stored.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_memap_read_any(libswd_ctx_t *libswdctx, int addr, int count, char *data){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG,
+            "LIBSWD_D: Entering libswd_memap_read_any(*libswdctx=%p, addr=0x%08X, count=0x%08X, *data=%p)...\n",
+            (void*)libswdctx, addr, count, (void*)data );
+
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (data==NULL) return LIBSWD_ERROR_NULLPOINTER;
+
+ int res, csw, *drw=NULL;
+ libswd_memap_plan_t plan;
+
+ res=libswd_memap_plan(addr, count, &plan);
+ if (res<0) goto libswd_memap_read_any_error;
+
+ // Initialize MEM-AP if necessary.
+ if (!libswdctx->log.memap.initialized)
+ {
+  res=libswd_memap_init(libswdctx, LIBSWD_OPERATION_EXECUTE);
+  if (res<0) goto libswd_memap_read_any_error;
+ }
+ csw=libswdctx->log.memap.csw;
+ libswdctx->memapresult.count=plan.head/plan.size+plan.bulk+plan.tail/plan.size;
+ libswdctx->memapresult.done=0;
+ libswdctx->memapresult.error=LIBSWD_OK;
+ libswdctx->memapresult.resumes=0;
+
+ // Serve from the read cache if the region allows.
+ res=libswd_memcache_read(libswdctx, addr, count, data);
+ if (res<0) goto libswd_memap_read_any_error;
+ if (res)
+ {
+  libswdctx->memapresult.done=libswdctx->memapresult.count;
+  return LIBSWD_OK;
+ }
+
+ // Aligned bulk goes straight to the buffer if it is aligned too.
+ if (plan.bulk)
+ {
+  drw=(int*)(data+plan.head);
+  if ((unsigned long)drw%sizeof(int))
+  {
+   drw=(int*)malloc(plan.bulk*sizeof(int));
+   if (drw==NULL)
+   {
+    res=LIBSWD_ERROR_OUTOFMEM;
+    goto libswd_memap_read_any_error;
+   }
+  }
+  res=libswd_memap_setup(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_CSW_SIZE_32BIT|LIBSWD_MEMAP_CSW_ADDRINC_SINGLE, libswdctx->log.memap.tar);
+  if (res>=0) res=libswd_memap_read_block(libswdctx, addr+plan.head, plan.bulk, drw);
+  if (res>=0) libswd_memap_drw2image(libswdctx, drw, plan.bulk, data+plan.head);
+  if (drw!=(int*)(data+plan.head)) free(drw);
+  if (res<0)
+  {
+   libswd_memap_setup(libswdctx, LIBSWD_OPERATION_EXECUTE, csw, libswdctx->log.memap.tar);
+   goto libswd_memap_read_any_error;
+  }
+ }
+
+ // Head and tail in one batch, that also restores CSW.
+ res=libswd_memap_plan_run(libswdctx, &plan, addr, 1, data, csw);
+ if (res<0) goto libswd_memap_read_any_error;
+ libswdctx->memapresult.done=libswdctx->memapresult.count;
+
+ return LIBSWD_OK;
+
+libswd_memap_read_any_error:
+ libswdctx->memapresult.error=res;
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR,
+            "LIBSWD_E: libswd_memap_read_any(): %s\n",
+            libswd_error_string(res) );
+ return res;
+}
+
+
+/** Write any number of bytes to any address using MEM-AP.
+ * Region is planned with libswd_memap_plan(), aligned bulk is written with
+ * 32-bit auto increment and unaligned head and tail in one batch after it.
+ * CSW is left as it was before the call.
+ * \param *libswdctx swd context to work on.
+ * \param addr is the start address of the data to write with MEM-AP.
+ * \param count is the number of bytes to write.
+ * \param *data is the pointer to data to be written.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_memap_write_any(libswd_ctx_t *libswdctx, int addr, int count, char *data){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG,
+            "LIBSWD_D: Entering libswd_memap_write_any(*libswdctx=%p, addr=0x%08X, count=0x%08X, *data=%p)...\n",
+            (void*)libswdctx, addr, count, (void*)data );
+
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (data==NULL) return LIBSWD_ERROR_NULLPOINTER;
+
+ int res, csw, *drw=NULL;
+ libswd_memap_plan_t plan;
+
+ res=libswd_memap_plan(addr, count, &plan);
+ if (res<0) goto libswd_memap_write_any_error;
+
+ // Initialize MEM-AP if necessary.
+ if (!libswdctx->log.memap.initialized)
+ {
+  res=libswd_memap_init(libswdctx, LIBSWD_OPERATION_EXECUTE);
+  if (res<0) goto libswd_memap_write_any_error;
+ }
+ csw=libswdctx->log.memap.csw;
+ libswdctx->memapresult.count=plan.head/plan.size+plan.bulk+plan.tail/plan.size;
+ libswdctx->memapresult.done=0;
+ libswdctx->memapresult.error=LIBSWD_OK;
+ libswdctx->memapresult.resumes=0;
+
+ // Aligned bulk goes straight from the buffer if it is aligned too.
+ if (plan.bulk)
+ {
+  drw=(int*)(data+plan.head);
+  if ((unsigned long)drw%sizeof(int) || libswdctx->log.memap.bswap)
+  {
+   drw=(int*)malloc(plan.bulk*sizeof(int));
+   if (drw==NULL)
+   {
+    res=LIBSWD_ERROR_OUTOFMEM;
+    goto libswd_memap_write_any_error;
+   }
+   libswd_memap_image2drw(libswdctx, data+plan.head, plan.bulk, drw);
+  }
+  res=libswd_memap_setup(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_CSW_SIZE_32BIT|LIBSWD_MEMAP_CSW_ADDRINC_SINGLE, libswdctx->log.memap.tar);
+  if (res>=0) res=libswd_memap_write_block(libswdctx, addr+plan.head, plan.bulk, drw);
+  if (drw!=(int*)(data+plan.head)) free(drw);
+  if (res<0)
+  {
+   libswd_memap_setup(libswdctx, LIBSWD_OPERATION_EXECUTE, csw, libswdctx->log.memap.tar);
+   goto libswd_memap_write_any_error;
+  }
+ }
+
+ // Head and tail in one batch, that also restores CSW.
+ res=libswd_memap_plan_run(libswdctx, &plan, addr, 0, data, csw);
+ if (res<0) goto libswd_memap_write_any_error;
+ libswdctx->memapresult.done=libswdctx->memapresult.count;
+
+ return LIBSWD_OK;
+
+libswd_memap_write_any_error:
+ libswdctx->memapresult.error=res;
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR,
+            "LIBSWD_E: libswd_memap_write_any(): %s\n",
+            libswd_error_string(res) );
+ return res;
+}
+
+
+/** Order scatter-gather regions by address, qsort() helper.
+ * \param *a is the pointer to the first libswd_memap_sg_t pointer.
+ * \param *b is the pointer to the second libswd_memap_sg_t pointer.
+ * \return negative, zero or positive like strcmp().
+ */
+int libswd_memap_sg_compare(const void *a, const void *b){
+ unsigned int addra=(unsigned int)(*(libswd_memap_sg_t**)a)->addr;
+ unsigned int addrb=(unsigned int)(*(libswd_memap_sg_t**)b)->addr;
+ return (addra>addrb)-(addra<addrb);
+}
+
+
+/** Append word transfers of one scatter-gather span to libswd_transfer() list.
+ * Span that fits the 16-byte window TAR already points to goes through
+ * Banked Data registers with no TAR write. Otherwise span is transferred
+ * with DRW auto increment and TAR is written at every auto increment window,
+ * as BD access after TAR write would only add APBANKSEL switches.
+ * \param *libswdctx swd context to work on.
+ * \param *list is the pointer to the first free (zeroed) list entry.
+ * \param *tar is the TAR value at this point of the list, updated on return.
+ * \param RnW is 1 for read, 0 for write.
+ * \param addr is the word aligned span address.
+ * \param count is the number of words in the span.
+ * \param *data is the pointer to span words.
+ * \return number of list entries appended.
+ */
+int libswd_memap_sg_enqueue(libswd_ctx_t *libswdctx, libswd_xfer_t *list, int *tar, char RnW, int addr, int count, int *data){
+ int i, j, k=0, n, loc;
+ int boundary=libswdctx->log.memap.tarwrap?libswdctx->log.memap.tarwrap:LIBSWD_MEMAP_TARWRAP_MIN;
+
+ loc=addr&~(LIBSWD_MEMAP_BD_WINDOW-1);
+ if (loc==*tar && loc==((addr+count*4-1)&~(LIBSWD_MEMAP_BD_WINDOW-1)))
+ {
+  for (i=0; i<count; i++, k++)
+  {
+   list[k].APnDP=1;
+   list[k].RnW=RnW;
+   list[k].addr=LIBSWD_MEMAP_BD0_ADDR+((addr+i*4)&(LIBSWD_MEMAP_BD_WINDOW-1));
+   list[k].data=&data[i];
+  }
+  return k;
+ }
+
+ for (i=0; i<count; i+=n)
+ {
+  loc=addr+i*4;
+  n=(boundary-(loc&(boundary-1)))/4;
+  if (n>count-i) n=count-i;
+  list[k].APnDP=1;
+  list[k].addr=LIBSWD_MEMAP_TAR_ADDR;
+  list[k++].value=loc;
+  for (j=0; j<n; j++, k++)
+  {
+   list[k].APnDP=1;
+   list[k].RnW=RnW;
+   list[k].addr=LIBSWD_MEMAP_DRW_ADDR;
+   list[k].data=&data[i+j];
+  }
+ }
+ *tar=LIBSWD_MEMAP_TAR_UNKNOWN;
+ return k;
+}
+
+
+/** Read scattered memory regions using MEM-AP.
+ * Regions are sorted by address and rounded to whole words. Regions that
+ * overlap or are closer than LIBSWD_MEMAP_SG_GAP are merged into one span,
+ * as reading the gap is cheaper than TAR rewrite. Spans longer than
+ * LIBSWD_MEMAP_SG_BULK words are read with the block engine, all the
+ * others in a single libswd_transfer() batch. Data are then scattered back
+ * to the region buffers. Note that gaps and word remainders are read too,
+ * so do not pass registers with read side effects next to each other.
+ * CSW is left as it was before the call.
+ * \param *libswdctx swd context to work on.
+ * \param *list is the array of regions to read.
+ * \param n is the number of regions.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_memap_read_sg(libswd_ctx_t *libswdctx, libswd_memap_sg_t *list, int n){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG,
+            "LIBSWD_D: Entering libswd_memap_read_sg(*libswdctx=%p, *list=%p, n=%d)...\n",
+            (void*)libswdctx, (void*)list, n );
+
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (list==NULL) return LIBSWD_ERROR_NULLPOINTER;
+ if (n<0) return LIBSWD_ERROR_PARAM;
+
+ int i, j, k, res, csw, tar, spans, words, entries, *span=NULL, *word=NULL;
+ unsigned int start, end;
+ libswd_memap_sg_t **sorted=NULL;
+ libswd_xfer_t *xfer=NULL;
+
+ libswdctx->memapresult.count=n;
+ libswdctx->memapresult.done=0;
+ libswdctx->memapresult.error=LIBSWD_OK;
+ libswdctx->memapresult.resumes=0;
+ if (n==0) return LIBSWD_OK;
+ libswd_stats_enter(libswdctx, LIBSWD_STATS_CLASS_MEMAP);
+
+ // Sort regions and merge them into spans: address, words, offset, member of.
+ sorted=(libswd_memap_sg_t**)malloc(n*sizeof(libswd_memap_sg_t*));
+ span=(int*)malloc(4*n*sizeof(int));
+ if (sorted==NULL || span==NULL)
+ {
+  res=LIBSWD_ERROR_OUTOFMEM;
+  goto libswd_memap_read_sg_error;
+ }
+ for (i=0; i<n; i++)
+ {
+  if (list[i].count>0 && list[i].data==NULL)
+  {
+   res=LIBSWD_ERROR_NULLPOINTER;
+   goto libswd_memap_read_sg_error;
+  }
+  sorted[i]=&list[i];
+ }
+ qsort((void*)sorted, n, sizeof(libswd_memap_sg_t*), libswd_memap_sg_compare);
+ for (i=0, spans=0; i<n; i++)
+ {
+  span[3*n+i]=-1;
+  if (sorted[i]->count<=0) continue;
+  start=((unsigned int)sorted[i]->addr)&~3;
+  end=((unsigned int)sorted[i]->addr+sorted[i]->count+3)&~3;
+  j=spans-1;
+  if (spans && start<=(unsigned int)span[j]+span[n+j]*4+LIBSWD_MEMAP_SG_GAP)
+  {
+   if (end>(unsigned int)span[j]+span[n+j]*4) span[n+j]=(end-(unsigned int)span[j])/4;
+  }
+  else
+  {
+   j=spans++;
+   span[j]=start;
+   span[n+j]=(end-start)/4;
+  }
+  span[3*n+i]=j;
+ }
+ for (j=0, words=0, entries=0; j<spans; j++)
+ {
+  span[2*n+j]=words;
+  words+=span[n+j];
+  if (span[n+j]<=LIBSWD_MEMAP_SG_BULK) entries+=span[n+j]+span[n+j]*4/LIBSWD_MEMAP_TARWRAP_MIN+2;
+ }
+ word=(int*)malloc(words*sizeof(int));
+ xfer=(libswd_xfer_t*)calloc(entries+1, sizeof(libswd_xfer_t));
+ if (word==NULL || xfer==NULL)
+ {
+  res=LIBSWD_ERROR_OUTOFMEM;
+  goto libswd_memap_read_sg_error;
+ }
+
+ // Initialize MEM-AP if necessary.
+ if (!libswdctx->log.memap.initialized)
+ {
+  res=libswd_memap_init(libswdctx, LIBSWD_OPERATION_EXECUTE);
+  if (res<0) goto libswd_memap_read_sg_error;
+ }
+ csw=libswdctx->log.memap.csw;
+ res=libswd_memap_setup(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_CSW_SIZE_32BIT|LIBSWD_MEMAP_CSW_ADDRINC_SINGLE, libswdctx->log.memap.tar);
+ if (res<0) goto libswd_memap_read_sg_error;
+
+ // Long spans go to the block engine first, the rest in one batch.
+ for (j=0; j<spans && res>=0; j++)
+  if (span[n+j]>LIBSWD_MEMAP_SG_BULK)
+   res=libswd_memap_read_block(libswdctx, span[j], span[n+j], &word[span[2*n+j]]);
+ if (res>=0)
+ {
+  tar=libswdctx->log.memap.tar;
+  for (j=0, k=0; j<spans; j++)
+   if (span[n+j]<=LIBSWD_MEMAP_SG_BULK)
+    k+=libswd_memap_sg_enqueue(libswdctx, &xfer[k], &tar, 1, span[j], span[n+j], &word[span[2*n+j]]);
+  if (k)
+  {
+   res=libswd_transfer(libswdctx, xfer, k, NULL);
+   libswdctx->log.memap.tar=(res<0)?LIBSWD_MEMAP_TAR_UNKNOWN:tar;
+  }
+ }
+ i=libswd_memap_setup(libswdctx, LIBSWD_OPERATION_EXECUTE, csw, libswdctx->log.memap.tar);
+ if (res>=0) res=i;
+ if (res<0) goto libswd_memap_read_sg_error;
+
+ // Spans are word aligned, convert them to memory image and scatter.
+ libswd_memap_drw2image(libswdctx, word, words, (char*)word);
+ for (i=0; i<n; i++)
+ {
+  j=span[3*n+i];
+  if (j<0) continue;
+  memcpy((void*)sorted[i]->data, (void*)((char*)&word[span[2*n+j]]+((unsigned int)sorted[i]->addr-(unsigned int)span[j])), sorted[i]->count);
+ }
+ libswdctx->memapresult.done=n;
+ free(xfer);
+ free(word);
+ free(span);
+ free(sorted);
+ if (libswdctx->statsctl.depth[LIBSWD_STATS_CLASS_MEMAP]==1)
+  for (i=0; i<n; i++) if (list[i].count>0) libswdctx->stats.bytes+=list[i].count;
+ libswd_stats_leave(libswdctx, LIBSWD_STATS_CLASS_MEMAP);
+ return LIBSWD_OK;
+
+libswd_memap_read_sg_error:
+ libswdctx->memapresult.error=res;
+ if (xfer) free(xfer);
+ if (word) free(word);
+ if (span) free(span);
+ if (sorted) free(sorted);
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR,
+            "LIBSWD_E: libswd_memap_read_sg(): %s\n",
+            libswd_error_string(res) );
+ libswd_stats_leave(libswdctx, LIBSWD_STATS_CLASS_MEMAP);
+ return res;
+}
+
+
+/** Write scattered memory regions using MEM-AP.
+ * Regions are sorted by address and the ones that overlap or touch each
+ * other are merged into one span (overlapping bytes are written in address
+ * order). Nothing outside of the regions is written. Whole words of the
+ * spans are written with 32-bit access, spans longer than LIBSWD_MEMAP_SG_BULK
+ * words with the block engine, all the others in a single libswd_transfer()
+ * batch that also writes unaligned span heads and tails with 8-bit access.
+ * CSW is left as it was before the call.
+ * \param *libswdctx swd context to work on.
+ * \param *list is the array of regions to write.
+ * \param n is the number of regions.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_memap_write_sg(libswd_ctx_t *libswdctx, libswd_memap_sg_t *list, int n){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG,
+            "LIBSWD_D: Entering libswd_memap_write_sg(*libswdctx=%p, *list=%p, n=%d)...\n",
+            (void*)libswdctx, (void*)list, n );
+
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (list==NULL) return LIBSWD_ERROR_NULLPOINTER;
+ if (n<0) return LIBSWD_ERROR_PARAM;
+
+ int i, j, k, res, csw, tar, spans, bytes, words, entries, loc, part, len, *span=NULL, *word=NULL;
+ unsigned int end;
+ char *image=NULL;
+ libswd_memap_sg_t **sorted=NULL;
+ libswd_memap_plan_t plan;
+ libswd_xfer_t *xfer=NULL;
+
+ libswdctx->memapresult.count=n;
+ libswdctx->memapresult.done=0;
+ libswdctx->memapresult.error=LIBSWD_OK;
+ libswdctx->memapresult.resumes=0;
+ if (n==0) return LIBSWD_OK;
+ libswd_stats_enter(libswdctx, LIBSWD_STATS_CLASS_MEMAP);
+
+ // Sort regions and merge them into spans: address, bytes, image offset, word offset.
+ sorted=(libswd_memap_sg_t**)malloc(n*sizeof(libswd_memap_sg_t*));
+ span=(int*)malloc(4*n*sizeof(int));
+ if (sorted==NULL || span==NULL)
+ {
+  res=LIBSWD_ERROR_OUTOFMEM;
+  goto libswd_memap_write_sg_error;
+ }
+ for (i=0; i<n; i++)
+ {
+  if (list[i].count>0 && list[i].data==NULL)
+  {
+   res=LIBSWD_ERROR_NULLPOINTER;
+   goto libswd_memap_write_sg_error;
+  }
+  sorted[i]=&list[i];
+ }
+ qsort((void*)sorted, n, sizeof(libswd_memap_sg_t*), libswd_memap_sg_compare);
+ for (i=0, spans=0; i<n; i++)
+ {
+  if (sorted[i]->count<=0) continue;
+  end=(unsigned int)sorted[i]->addr+sorted[i]->count;
+  j=spans-1;
+  if (spans && (unsigned int)sorted[i]->addr<=(unsigned int)span[j]+span[n+j])
+  {
+   if (end>(unsigned int)span[j]+span[n+j]) span[n+j]=end-(unsigned int)span[j];
+  }
+  else
+  {
+   j=spans++;
+   span[j]=sorted[i]->addr;
+   span[n+j]=sorted[i]->count;
+  }
+ }
+ for (j=0, bytes=0, words=0, entries=0; j<spans; j++)
+ {
+  libswd_memap_plan(span[j], span[n+j], &plan);
+  span[2*n+j]=bytes;
+  span[3*n+j]=words;
+  bytes+=span[n+j];
+  words+=plan.bulk;
+  if (plan.bulk<=LIBSWD_MEMAP_SG_BULK) entries+=plan.bulk+plan.bulk*4/LIBSWD_MEMAP_TARWRAP_MIN+2;
+  entries+=plan.head+plan.tail+2;
+ }
+ word=(int*)malloc((words+1)*sizeof(int));
+ image=(char*)malloc(bytes);
+ xfer=(libswd_xfer_t*)calloc(entries+2, sizeof(libswd_xfer_t));
+ if (word==NULL || image==NULL || xfer==NULL)
+ {
+  res=LIBSWD_ERROR_OUTOFMEM;
+  goto libswd_memap_write_sg_error;
+ }
+
+ // Build span images, then DRW values of their whole words.
+ for (i=0, j=0; i<n; i++)
+ {
+  if (sorted[i]->count<=0) continue;
+  while ((unsigned int)sorted[i]->addr>=(unsigned int)span[j]+span[n+j]) j++;
+  memcpy((void*)(image+span[2*n+j]+((unsigned int)sorted[i]->addr-(unsigned int)span[j])), (void*)sorted[i]->data, sorted[i]->count);
+ }
+ for (j=0; j<spans; j++) libswd_memcache_invalidate(libswdctx, span[j], span[n+j]);
+ for (j=0; j<spans; j++)
+ {
+  libswd_memap_plan(span[j], span[n+j], &plan);
+  libswd_memap_image2drw(libswdctx, image+span[2*n+j]+plan.head, plan.bulk, &word[span[3*n+j]]);
+ }
+
+ // Initialize MEM-AP if necessary.
+ if (!libswdctx->log.memap.initialized)
+ {
+  res=libswd_memap_init(libswdctx, LIBSWD_OPERATION_EXECUTE);
+  if (res<0) goto libswd_memap_write_sg_error;
+ }
+ csw=libswdctx->log.memap.csw;
+ res=libswd_memap_setup(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_CSW_SIZE_32BIT|LIBSWD_MEMAP_CSW_ADDRINC_SINGLE, libswdctx->log.memap.tar);
+ if (res<0) goto libswd_memap_write_sg_error;
+
+ // Long spans go to the block engine first, the rest in one batch.
+ for (j=0; j<spans && res>=0; j++)
+ {
+  libswd_memap_plan(span[j], span[n+j], &plan);
+  if (plan.bulk>LIBSWD_MEMAP_SG_BULK)
+   res=libswd_memap_write_block(libswdctx, span[j]+plan.head, plan.bulk, &word[span[3*n+j]]);
+ }
+ if (res<0)
+ {
+  libswd_memap_setup(libswdctx, LIBSWD_OPERATION_EXECUTE, csw, libswdctx->log.memap.tar);
+  goto libswd_memap_write_sg_error;
+ }
+ tar=libswdctx->log.memap.tar;
+ for (j=0, k=0; j<spans; j++)
+ {
+  libswd_memap_plan(span[j], span[n+j], &plan);
+  if (plan.bulk && plan.bulk<=LIBSWD_MEMAP_SG_BULK)
+   k+=libswd_memap_sg_enqueue(libswdctx, &xfer[k], &tar, 0, span[j]+plan.head, plan.bulk, &word[span[3*n+j]]);
+ }
+
+ // Unaligned heads and tails of all spans go after a single CSW switch.
+ for (j=0, i=k; j<spans; j++)
+ {
+  libswd_memap_plan(span[j], span[n+j], &plan);
+  for (part=0; part<2; part++)
+  {
+   loc=part?span[j]+plan.head+plan.bulk*4:span[j];
+   len=part?plan.tail:plan.head;
+   if (!len) continue;
+   if (k==i)
+   {
+    xfer[k].APnDP=1;
+    xfer[k].addr=LIBSWD_MEMAP_CSW_ADDR;
+    xfer[k].value=(csw&~(LIBSWD_MEMAP_CSW_SIZE|LIBSWD_MEMAP_CSW_ADDRINC));
+    xfer[k++].value|=LIBSWD_MEMAP_CSW_SIZE_8BIT|LIBSWD_MEMAP_CSW_ADDRINC_SINGLE|LIBSWD_MEMAP_CSW_DBGSWENABLE|LIBSWD_MEMAP_CSW_PROT;
+   }
+   xfer[k].APnDP=1;
+   xfer[k].addr=LIBSWD_MEMAP_TAR_ADDR;
+   xfer[k++].value=loc;
+   // Every byte goes to the DRW lane given by its address.
+   for (; len>0; len--, loc++, k++)
+   {
+    xfer[k].APnDP=1;
+    xfer[k].addr=LIBSWD_MEMAP_DRW_ADDR;
+    xfer[k].value=((unsigned int)(unsigned char)image[span[2*n+j]+(loc-span[j])])<<LIBSWD_MEMAP_LANE(libswdctx, loc);
+   }
+   tar=LIBSWD_MEMAP_TAR_UNKNOWN;
+  }
+ }
+ if (k>i)
+ {
+  xfer[k].APnDP=1;
+  xfer[k].addr=LIBSWD_MEMAP_CSW_ADDR;
+  xfer[k++].value=csw;
+ }
+ if (k)
+ {
+  res=libswd_transfer(libswdctx, xfer, k, NULL);
+  libswdctx->log.memap.tar=(res<0)?LIBSWD_MEMAP_TAR_UNKNOWN:tar;
+  if (k>i)
+  {
+   // Batch has switched CSW, put it back in sync with the target on failure.
+   if (res<0 && libswd_ap_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_CSW_ADDR, &csw)<0)
+    libswdctx->log.memap.initialized=0;
+   libswdctx->log.memap.csw=csw;
+  }
+ }
+ i=libswd_memap_setup(libswdctx, LIBSWD_OPERATION_EXECUTE, csw, libswdctx->log.memap.tar);
+ if (res>=0) res=i;
+ if (res<0) goto libswd_memap_write_sg_error;
+ libswdctx->memapresult.done=n;
+ free(xfer);
+ free(image);
+ free(word);
+ free(span);
+ free(sorted);
+ if (libswdctx->statsctl.depth[LIBSWD_STATS_CLASS_MEMAP]==1)
+  for (i=0; i<n; i++) if (list[i].count>0) libswdctx->stats.bytes+=list[i].count;
+ libswd_stats_leave(libswdctx, LIBSWD_STATS_CLASS_MEMAP);
+ return LIBSWD_OK;
+
+libswd_memap_write_sg_error:
+ libswdctx->memapresult.error=res;
+ if (xfer) free(xfer);
+ if (image) free(image);
+ if (word) free(word);
+ if (span) free(span);
+ if (sorted) free(sorted);
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR,
+            "LIBSWD_E: libswd_memap_write_sg(): %s\n",
+            libswd_error_string(res) );
+ libswd_stats_leave(libswdctx, LIBSWD_STATS_CLASS_MEMAP);
+ return res;
+}
+
+
+/** Write one streaming dump chunk to the output file.
+ * Used as the writer thread body by libswd_memap_dump(), result is stored
+ * in the chunk itself as the thread does not touch the context.
+ * \param *chunk is the libswd_memap_dump_t to write.
+ * \return the chunk pointer.
+ */
+void *libswd_memap_dump_write(void *chunk){
+ libswd_memap_dump_t *dump=(libswd_memap_dump_t*)chunk;
+ if (fwrite(dump->data, sizeof(char), dump->count, dump->fp)!=(size_t)dump->count)
+  dump->res=LIBSWD_ERROR_FILE;
+ else dump->res=LIBSWD_OK;
+ return chunk;
+}
+
+/** Stream target memory into a file with bounded host memory.
+ * Region is read with libswd_memap_read_any() in chunks into two
+ * alternating buffers. When pthreads are available a writer thread stores
+ * the previous chunk to the file while the next one is read over SWD,
+ * otherwise chunks are written synchronously. Host memory use is two chunks
+ * regardless of the region size. Progress is reported per chunk, see
+ * libswd_stats_progress_set().
+ * \param *libswdctx swd context to work on.
+ * \param addr is the start address of the region to dump.
+ * \param count is the number of bytes to dump.
+ * \param *fp is the output file opened for writing.
+ * \param chunk is the chunk size in bytes, 0 for LIBSWD_MEMAP_DUMP_CHUNK.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_memap_dump(libswd_ctx_t *libswdctx, int addr, int count, FILE *fp, int chunk){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG,
+            "LIBSWD_D: Entering libswd_memap_dump(*libswdctx=%p, addr=0x%08X, count=0x%08X, *fp=%p, chunk=%d)...\n",
+            (void*)libswdctx, addr, count, (void*)fp, chunk );
+
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (fp==NULL) return LIBSWD_ERROR_NULLPOINTER;
+ if (count<0 || chunk<0) return LIBSWD_ERROR_PARAM;
+ if (count==0) return LIBSWD_OK;
+
+ int i, n, res=LIBSWD_OK, cur=0, busy=0;
+ char *buf[2]={NULL, NULL};
+ libswd_memap_dump_t writer;
+#ifdef HAVE_PTHREAD
+ pthread_t thread;
+#endif
+
+ // Keep chunks word aligned, so TAR windows of consecutive chunks line up.
+ if (!chunk) chunk=LIBSWD_MEMAP_DUMP_CHUNK;
+ if (chunk>count) chunk=count+3;
+ chunk&=~3;
+ if (!chunk) chunk=4;
+ buf[0]=(char*)malloc(chunk);
+ buf[1]=(char*)malloc(chunk);
+ if (buf[0]==NULL || buf[1]==NULL)
+ {
+  res=LIBSWD_ERROR_OUTOFMEM;
+  goto libswd_memap_dump_error;
+ }
+ writer.res=LIBSWD_OK;
+
+ libswd_stats_enter(libswdctx, LIBSWD_STATS_CLASS_MEMAP);
+ for (i=0; i<count; i+=n)
+ {
+  n=(count-i<chunk)?count-i:chunk;
+  // Previous chunk is being written while this one is read.
+  res=libswd_memap_read_any(libswdctx, addr+i, n, buf[cur]);
+  if (res<0) break;
+#ifdef HAVE_PTHREAD
+  if (busy) pthread_join(thread, NULL);
+  busy=0;
+#endif
+  if (writer.res<0) break;
+  writer.fp=fp;
+  writer.data=buf[cur];
+  writer.count=n;
+#ifdef HAVE_PTHREAD
+  if (pthread_create(&thread, NULL, libswd_memap_dump_write, (void*)&writer)==0) busy=1;
+  else libswd_memap_dump_write((void*)&writer);
+#else
+  libswd_memap_dump_write((void*)&writer);
+#endif
+  if (libswdctx->statsctl.depth[LIBSWD_STATS_CLASS_MEMAP]==1) libswdctx->stats.bytes+=n;
+  libswd_stats_progress(libswdctx, i+n, count);
+  cur^=1;
+ }
+#ifdef HAVE_PTHREAD
+ if (busy) pthread_join(thread, NULL);
+#endif
+ libswd_stats_leave(libswdctx, LIBSWD_STATS_CLASS_MEMAP);
+ if (res>=0) res=writer.res;
+ if (res<0) goto libswd_memap_dump_error;
+ free(buf[0]);
+ free(buf[1]);
+ return LIBSWD_OK;
+
+libswd_memap_dump_error:
+ if (buf[0]) free(buf[0]);
+ if (buf[1]) free(buf[1]);
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR,
+            "LIBSWD_E: libswd_memap_dump(): %s\n",
+            libswd_error_string(res) );
+ return res;
+}
+
+
+/** Fill target memory with a repeated pattern, no host data buffer is used.
+ * Pattern of given width is replicated into a 32-bit DRW value, aligned bulk
+ * is written with the block engine streaming this one value (TAR is written
+ * once per auto increment window), unaligned head and tail go in a single
+ * plan batch each (see libswd_memap_plan_run()). CSW is left as it was.
+ * When the core is halted and work area is set (see libswd_stub_workarea())
+ * bulk of at least LIBSWD_STUB_FILL_MIN bytes outside the work area is
+ * filled by the on-target routine instead.
+ * \param *libswdctx swd context to work on.
+ * \param addr is the start address of the region, aligned to width.
+ * \param count is the number of bytes to fill, multiple of width.
+ * \param pattern is the value to fill memory with, low width bytes are used.
+ * \param width is the pattern size in bytes, 1, 2 or 4.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_memap_fill(libswd_ctx_t *libswdctx, int addr, int count, int pattern, int width){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG,
+            "LIBSWD_D: Entering libswd_memap_fill(*libswdctx=%p, addr=0x%08X, count=0x%08X, pattern=0x%08X, width=%d)...\n",
+            (void*)libswdctx, addr, count, pattern, width );
+
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (width!=1 && width!=2 && width!=4) return LIBSWD_ERROR_PARAM;
+ if (count<0) return LIBSWD_ERROR_PARAM;
+ if ((addr|count)&(width-1)) return LIBSWD_ERROR_MEMAPALIGN;
+
+ int i, j, res, csw, word, loc, stub;
+ char bytes[8];
+ libswd_memap_plan_t plan, part;
+
+ // Replicate pattern over all byte lanes.
+ switch (width)
+ {
+  case 1: word=(pattern&0xFF)*0x01010101; break;
+  case 2: word=(pattern&0xFFFF)*0x00010001; break;
+  default: word=pattern;
+ }
+ res=libswd_memap_plan(addr, count, &plan);
+ if (res<0) goto libswd_memap_fill_error;
+
+ // Initialize MEM-AP if necessary.
+ if (!libswdctx->log.memap.initialized)
+ {
+  res=libswd_memap_init(libswdctx, LIBSWD_OPERATION_EXECUTE);
+  if (res<0) goto libswd_memap_fill_error;
+ }
+ csw=libswdctx->log.memap.csw;
+ libswdctx->memapresult.count=plan.head/plan.size+plan.bulk+plan.tail/plan.size;
+ libswdctx->memapresult.done=0;
+ libswdctx->memapresult.error=LIBSWD_OK;
+ libswdctx->memapresult.resumes=0;
+
+ libswd_stats_enter(libswdctx, LIBSWD_STATS_CLASS_MEMAP);
+ stub=libswdctx->config.stubaddr;
+ if (plan.bulk*4>=LIBSWD_STUB_FILL_MIN && libswdctx->config.stubsize
+     && libswd_debug_is_halted(libswdctx, LIBSWD_OPERATION_EXECUTE)==1
+     && (unsigned int)(stub-(addr+plan.head))>=(unsigned int)(plan.bulk*4)
+     && (unsigned int)(addr+plan.head-stub)>=(unsigned int)libswdctx->config.stubsize)
+ {
+  // Halted core fills large bulk itself, only the routine crosses the wire.
+  res=libswd_stub_fill(libswdctx, addr+plan.head, plan.bulk*4, word);
+  if (res<0) goto libswd_memap_fill_leave;
+ }
+ else if (plan.bulk)
+ {
+  res=libswd_memap_setup(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_CSW_SIZE_32BIT|LIBSWD_MEMAP_CSW_ADDRINC_SINGLE, libswdctx->log.memap.tar);
+  if (res>=0) res=libswd_memap_write_block_stride(libswdctx, addr+plan.head, plan.bulk, &word, 0);
+  if (res<0)
+  {
+   libswd_memap_setup(libswdctx, LIBSWD_OPERATION_EXECUTE, csw, libswdctx->log.memap.tar);
+   goto libswd_memap_fill_leave;
+  }
+ }
+
+ // Head and tail are separated by the bulk, so each gets its own plan.
+ for (j=0; j<2; j++)
+ {
+  part=plan;
+  part.bulk=0;
+  if (j) part.head=0; else part.tail=0;
+  loc=j?addr+plan.head+plan.bulk*4:addr;
+  if (j && !part.tail) continue;
+  for (i=0; i<part.head+part.tail; i++) bytes[i]=(char)(word>>LIBSWD_MEMAP_LANE(libswdctx, loc+i));
+  res=libswd_memap_plan_run(libswdctx, &part, loc, 0, bytes, csw);
+  if (res<0) goto libswd_memap_fill_leave;
+ }
+ libswdctx->memapresult.done=libswdctx->memapresult.count;
+ if (libswdctx->statsctl.depth[LIBSWD_STATS_CLASS_MEMAP]==1) libswdctx->stats.bytes+=count;
+
+libswd_memap_fill_leave:
+ libswd_stats_leave(libswdctx, LIBSWD_STATS_CLASS_MEMAP);
+ if (res>=0) return LIBSWD_OK;
+
+libswd_memap_fill_error:
+ libswdctx->memapresult.error=res;
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR,
+            "LIBSWD_E: libswd_memap_fill(): %s\n",
+            libswd_error_string(res) );
+ return res;
+}
+
+
+/** Verify target memory against int array with ADIv5 pushed-verify.
+ * Expected words are written to DRW with CTRL/STAT TRNMODE set to pushed
+ * verify, so DAP compares them with target memory and only STICKYCMP is
+ * checked once per TAR chunk, readback data never crosses the wire.
+ * When STICKYCMP is set the chunk is read back to locate the first
+ * mismatching word, its address is stored in libswdctx->memapresult.addr
+ * and number of matching words before it in libswdctx->memapresult.done.
+ * Remember to setup CSW for 32-bit access first!
+ * \param *libswdctx swd context to work on.
+ * \param operation can be LIBSWD_OPERATION_ENQUEUE or LIBSWD_OPERATION_EXECUTE.
+ * \param addr is the start address of the data to verify with MEM-AP.
+ * \param count is the number of words to verify.
+ * \param *data is the pointer to int data array with expected values.
+ * \return LIBSWD_OK when memory matches, LIBSWD_ERROR_MISMATCH or other LIBSWD_ERROR code on failure.
+ */
+int libswd_memap_verify_int(libswd_ctx_t *libswdctx, libswd_operation_t operation, int addr, int count, int *data){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG,
+            "LIBSWD_D: Entering libswd_memap_verify_int(*libswdctx=%p, operation=%s, addr=0x%08X, count=0x%08X, **data=%p)...\n",
+            (void*)libswdctx, libswd_operation_string(operation),
+            addr, count, (void*)data);
+
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (data==NULL) return LIBSWD_ERROR_NULLPOINTER;
+ if (operation!=LIBSWD_OPERATION_ENQUEUE && operation!=LIBSWD_OPERATION_EXECUTE)
+  return LIBSWD_ERROR_BADOPCODE;
+
+ int i, n, j, loc, res=0, *ctrlstat, abort, *readback=NULL;
+ int boundary=libswdctx->log.memap.tarwrap?libswdctx->log.memap.tarwrap:LIBSWD_MEMAP_TARWRAP_MIN;
+
+ libswdctx->memapresult.count=count;
+ libswdctx->memapresult.done=0;
+ libswdctx->memapresult.addr=addr;
+ libswdctx->memapresult.error=LIBSWD_OK;
+ libswdctx->memapresult.resumes=0;
+
+ // Initialize MEM-AP if necessary.
+ if (!libswdctx->log.memap.initialized)
+ {
+  res=libswd_memap_init(libswdctx, operation);
+  if (res<0) goto libswd_memap_verify_int_error;
+ }
+ if ((libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_SIZE)!=LIBSWD_MEMAP_CSW_SIZE_32BIT)
+ {
+  res=LIBSWD_ERROR_MEMAPACCSIZE;
+  goto libswd_memap_verify_int_error;
+ }
+
+ // Start with clean STICKYCMP.
+ abort=LIBSWD_DP_ABORT_STKCMPCLR;
+ res=libswd_dp_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_DP_ABORT_ADDR, &abort);
+ if (res<0) goto libswd_memap_verify_int_error;
+
+ // Verify in chunks that do not cross TAR auto increment boundary.
+ // TAR write would be turned into pushed operation too,
+ // so TRNMODE is switched to normal for every TAR write.
+ for (i=0; i<count; i+=n)
+ {
+  loc=addr+i*4;
+  libswdctx->memapresult.addr=loc;
+  n=1;
+  if (libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_ADDRINC)
+  {
+   n=(boundary-(loc&(boundary-1)))/4;
+   if (n>count-i) n=count-i;
+  }
+  res=libswd_ap_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_TAR_ADDR, &loc);
+  if (res<0) goto libswd_memap_verify_int_error;
+  libswdctx->log.memap.tar=(libswdctx->log.memap.csw&LIBSWD_MEMAP_CSW_ADDRINC)?LIBSWD_MEMAP_TAR_UNKNOWN:loc;
+  res=libswd_dap_trnmode(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_TRNMODE_PUSHEDVERIFY, LIBSWD_MASKLANE_ALL);
+  if (res<0) goto libswd_memap_verify_int_error;
+  res=libswd_ap_write_stream(libswdctx, LIBSWD_MEMAP_DRW_ADDR, &data[i], n);
+  if (res>=0) res=libswd_dp_read(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_DP_CTRLSTAT_ADDR, &ctrlstat);
+  j=libswd_dap_trnmode(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_TRNMODE_NORMAL, 0);
+  if (res>=0) res=j;
+  if (res<0) goto libswd_memap_verify_int_error;
+  if (*ctrlstat&LIBSWD_DP_CTRLSTAT_STICKYCMP) break;
+  libswdctx->memapresult.done=i+n;
+ }
+ if (i>=count)
+ {
+  libswdctx->memapresult.addr=addr+count*4;
+  return LIBSWD_OK;
+ }
+
+ // Mismatch in this chunk, read it back to find the failing word.
+ abort=LIBSWD_DP_ABORT_STKCMPCLR;
+ res=libswd_dp_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_DP_ABORT_ADDR, &abort);
+ if (res<0) goto libswd_memap_verify_int_error;
+ readback=(int*)malloc(n*sizeof(int));
+ if (readback==NULL)
+ {
+  res=LIBSWD_ERROR_OUTOFMEM;
+  goto libswd_memap_verify_int_error;
+ }
+ res=libswd_memap_read_int(libswdctx, operation, loc, n, readback);
+ if (res<0) goto libswd_memap_verify_int_error;
+ j=libswd_bin_compare((char*)readback, (char*)(data+i), n*4)/4;
+ if (j>n-1) j=n-1;
+ free(readback);
+ libswdctx->memapresult.count=count;
+ libswdctx->memapresult.done=i+j;
+ libswdctx->memapresult.addr=loc+j*4;
+ libswdctx->memapresult.error=LIBSWD_ERROR_MISMATCH;
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO,
+            "LIBSWD_I: libswd_memap_verify_int(): mismatch at 0x%08X\n",
+            libswdctx->memapresult.addr );
+ return LIBSWD_ERROR_MISMATCH;
+
+libswd_memap_verify_int_error:
+ if (readback) free(readback);
+ libswdctx->memapresult.error=res;
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR,
+            "LIBSWD_E: libswd_memap_verify_int(): %s at 0x%08X after %d of %d words\n",
+            libswd_error_string(res), libswdctx->memapresult.addr,
+            libswdctx->memapresult.done, count );
+ return res;
+}
+
+/** Verify target memory against int array, with prior 32-bit MEM-AP access setup.
+ * \param *libswdctx swd context to work on.
+ * \param operation can be LIBSWD_OPERATION_ENQUEUE or LIBSWD_OPERATION_EXECUTE.
+ * \param addr is the start address of the data to verify with MEM-AP.
+ * \param count is the number of words to verify.
+ * \param *data is the pointer to int data array with expected values.
+ * \return LIBSWD_OK when memory matches, LIBSWD_ERROR_MISMATCH or other LIBSWD_ERROR code on failure.
+ */
+int libswd_memap_verify_int_32(libswd_ctx_t *libswdctx, libswd_operation_t operation, int addr, int count, int *data){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG,
+            "LIBSWD_D: Entering libswd_memap_verify_int_32(*libswdctx=%p, operation=%s, addr=0x%08X, count=0x%08X, **data=%p)...\n",
+            (void*)libswdctx, libswd_operation_string(operation),
+            addr, count, (void**)data);
+
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ int res;
+ res=libswd_memap_setup(libswdctx, operation, LIBSWD_MEMAP_CSW_SIZE_32BIT|LIBSWD_MEMAP_CSW_ADDRINC_SINGLE, addr);
+ if (res<0) return res;
+ return libswd_memap_verify_int(libswdctx, operation, addr, count, data);
+}
+
+
+/** Poll the memory mapped register until (*addr&mask)==(value&mask).
+ * Register is compared on target with ADIv5 pushed-compare, each poll is a
+ * single DRW write transaction, a burst of LIBSWD_MEMAP_POLL_BURST writes
+ * is followed by one CTRL/STAT read to check STICKYCMP. Pushed-compare
+ * works on byte lanes (MASKLANE), so the register is read before every
+ * burst to take remaining bits of the compared lanes from that value.
+ * \param *libswdctx swd context to work on.
+ * \param addr is the register address.
+ * \param mask selects bits to compare.
+ * \param value is the expected value of masked bits.
+ * \param timeout is the poll deadline [us].
+ * \param delay is the initial delay [us] between bursts, doubled up to config.waitdelaymax, 0 for no delay.
+ * \param *data if not NULL will hold the last register value.
+ * \return LIBSWD_OK on match, LIBSWD_ERROR_TIMEOUT or other LIBSWD_ERROR code on failure.
+ */
+int libswd_memap_poll(libswd_ctx_t *libswdctx, int addr, int mask, int value, int timeout, int delay, int *data){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG,
+            "LIBSWD_D: Entering libswd_memap_poll(*libswdctx=%p, addr=0x%08X, mask=0x%08X, value=0x%08X, timeout=%d, delay=%d)...\n",
+            (void*)libswdctx, addr, mask, value, timeout, delay);
+
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+
+ int i, res, reg, csw, masklane=0, abort, *ctrlstat, burst[LIBSWD_MEMAP_POLL_BURST];
+ long elapsed;
+ struct timeval tstart, tnow;
+
+ if (!libswdctx->log.memap.initialized)
+ {
+  res=libswd_memap_init(libswdctx, LIBSWD_OPERATION_EXECUTE);
+  if (res<0) return res;
+ }
+ csw=libswdctx->log.memap.csw;
+ for (i=0; i<4; i++)
+  if (mask&(0xFF<<(i*8))) masklane|=1<<i;
+
+ gettimeofday(&tstart, NULL);
+ for (;;)
+ {
+  // Read the register with TAR fixed, so it can be compared repeatedly.
+  res=libswd_memap_read_int_csw(libswdctx, LIBSWD_OPERATION_EXECUTE, addr, 1, &reg, LIBSWD_MEMAP_CSW_SIZE_32BIT|LIBSWD_MEMAP_CSW_ADDRINC_OFF);
+  if (res<0) goto libswd_memap_poll_error;
+  if (data) *data=reg;
+  if ((reg&mask)==(value&mask)) break;
+  gettimeofday(&tnow, NULL);
+  elapsed=(tnow.tv_sec-tstart.tv_sec)*1000000+(tnow.tv_usec-tstart.tv_usec);
+  if (elapsed>=timeout)
+  {
+   res=LIBSWD_ERROR_TIMEOUT;
+   goto libswd_memap_poll_error;
+  }
+  if (delay>0)
+  {
+   usleep(delay);
+   delay*=2;
+   if (delay>libswdctx->config.waitdelaymax) delay=libswdctx->config.waitdelaymax;
+  }
+  // Compare on target until match is reported with STICKYCMP.
+  for (i=0; i<LIBSWD_MEMAP_POLL_BURST; i++) burst[i]=(reg&~mask)|(value&mask);
+  res=libswd_dap_trnmode(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_TRNMODE_PUSHEDCOMPARE, masklane);
+  if (res<0) goto libswd_memap_poll_error;
+  res=libswd_ap_write_stream(libswdctx, LIBSWD_MEMAP_DRW_ADDR, burst, LIBSWD_MEMAP_POLL_BURST);
+  if (res>=0) res=libswd_dp_read(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_DP_CTRLSTAT_ADDR, &ctrlstat);
+  i=libswd_dap_trnmode(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_TRNMODE_NORMAL, 0);
+  if (res>=0) res=i;
+  if (res<0) goto libswd_memap_poll_error;
+  if (*ctrlstat&LIBSWD_DP_CTRLSTAT_STICKYCMP)
+  {
+   // Matched, clear the flag and confirm with the register read.
+   abort=LIBSWD_DP_ABORT_STKCMPCLR;
+   res=libswd_dp_write(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_DP_ABORT_ADDR, &abort);
+   if (res<0) goto libswd_memap_poll_error;
+  }
+ }
+
+ // Restore CSW of the caller.
+ res=libswd_memap_setup(libswdctx, LIBSWD_OPERATION_EXECUTE, csw, libswdctx->log.memap.tar);
+ if (res<0) goto libswd_memap_poll_error;
+ return LIBSWD_OK;
+
+libswd_memap_poll_error:
+ libswd_memap_setup(libswdctx, LIBSWD_OPERATION_EXECUTE, csw, libswdctx->log.memap.tar);
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR,
+            "LIBSWD_E: libswd_memap_poll(): %s polling 0x%08X\n",
+            libswd_error_string(res), addr );
+ return res;
+}
+
+
+/** Enable MEM-AP read cache.
+ * Reads of cacheable regions (see libswd_memcache_region()) are then served
+ * page by page from host memory, only missing pages are read from target.
+ * Cache is invalidated on any write to the range, on run control (DHCSR,
+ * AIRCR) writes, on libswd_debug_run() and on DAP (re)initialization.
+ * Enabling already enabled cache drops its content, keeps the regions.
+ * \param *libswdctx swd context to work on.
+ * \param pages is the number of cache pages.
+ * \param pagesize is the page size in bytes, power of two from 4 to 1024.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_memcache_enable(libswd_ctx_t *libswdctx, int pages, int pagesize){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (pages<1 || pagesize<4 || pagesize>LIBSWD_MEMAP_TARWRAP_MIN || (pagesize&(pagesize-1)))
+  return LIBSWD_ERROR_PARAM;
+
+ int i;
+
+ libswd_memcache_disable(libswdctx);
+ libswdctx->memcache.page=(libswd_memcache_page_t*)calloc(pages, sizeof(libswd_memcache_page_t));
+ libswdctx->memcache.data=(unsigned char*)malloc(pages*pagesize);
+ if (libswdctx->memcache.page==NULL || libswdctx->memcache.data==NULL)
+ {
+  libswd_memcache_disable(libswdctx);
+  return LIBSWD_ERROR_OUTOFMEM;
+ }
+ for (i=0; i<pages; i++) libswdctx->memcache.page[i].data=libswdctx->memcache.data+i*pagesize;
+ libswdctx->memcache.pagecount=pages;
+ libswdctx->memcache.pagesize=pagesize;
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO,
+            "LIBSWD_I: libswd_memcache_enable(): %d pages of %d bytes\n",
+            pages, pagesize );
+ return LIBSWD_OK;
+}
+
+
+/** Disable MEM-AP read cache and free its memory.
+ * Region policies and statistics are kept.
+ * \param *libswdctx swd context to work on.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_memcache_disable(libswd_ctx_t *libswdctx){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (libswdctx->memcache.page) free(libswdctx->memcache.page);
+ if (libswdctx->memcache.data) free(libswdctx->memcache.data);
+ libswdctx->memcache.page=NULL;
+ libswdctx->memcache.data=NULL;
+ libswdctx->memcache.pagecount=0;
+ libswdctx->memcache.pagesize=0;
+ return LIBSWD_OK;
+}
+
+
+/** Set MEM-AP read cache policy for memory region.
+ * Regions added later take precedence over earlier ones. Memory not covered
+ * by any region is cached while halted below LIBSWD_MEMCACHE_DEFAULT_LIMIT
+ * (code and SRAM) and never above it (peripherals and system space).
+ * Pages already held in cache for the region are dropped.
+ * \param *libswdctx swd context to work on.
+ * \param addr is the region start address.
+ * \param size is the region size [bytes].
+ * \param policy is one of LIBSWD_MEMCACHE_POLICY_* values.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_memcache_region(libswd_ctx_t *libswdctx, int addr, int size, char policy){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (size<=0 || policy<LIBSWD_MEMCACHE_POLICY_NEVER || policy>LIBSWD_MEMCACHE_POLICY_ALWAYS)
+  return LIBSWD_ERROR_PARAM;
+ if (libswdctx->memcache.regioncount>=LIBSWD_MEMCACHE_REGIONS) return LIBSWD_ERROR_OUTOFMEM;
+
+ libswd_memcache_region_t *region=&libswdctx->memcache.region[libswdctx->memcache.regioncount++];
+ region->addr=addr;
+ region->size=size;
+ region->policy=policy;
+ libswd_memcache_invalidate(libswdctx, addr, size);
+ return LIBSWD_OK;
+}
+
+
+/** Find MEM-AP read cache policy of given address.
+ * \param *libswdctx swd context to work on.
+ * \param addr is the address to check.
+ * \return one of LIBSWD_MEMCACHE_POLICY_* values or LIBSWD_ERROR code on failure.
+ */
+int libswd_memcache_region_policy(libswd_ctx_t *libswdctx, int addr){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+
+ int i;
+
+ for (i=libswdctx->memcache.regioncount-1; i>=0; i--)
+  if ((unsigned int)(addr-libswdctx->memcache.region[i].addr)<(unsigned int)libswdctx->memcache.region[i].size)
+   return libswdctx->memcache.region[i].policy;
+ return ((unsigned int)addr<LIBSWD_MEMCACHE_DEFAULT_LIMIT)?LIBSWD_MEMCACHE_POLICY_HALTED:LIBSWD_MEMCACHE_POLICY_NEVER;
+}
+
+
+/** Tell if given address can be served from MEM-AP read cache right now.
+ * \param *libswdctx swd context to work on.
+ * \param addr is the address to check.
+ * \return 1 if cacheable, 0 if not, LIBSWD_ERROR code on failure.
+ */
+int libswd_memcache_policy(libswd_ctx_t *libswdctx, int addr){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+
+ int policy;
+
+ policy=libswd_memcache_region_policy(libswdctx, addr);
+ if (policy==LIBSWD_MEMCACHE_POLICY_ALWAYS) return 1;
+ if (policy==LIBSWD_MEMCACHE_POLICY_HALTED) return (libswdctx->log.debug.dhcsr&LIBSWD_ARM_DEBUG_DHCSR_SHALT)?1:0;
+ return 0;
+}
+
+
+/** Drop whole MEM-AP read cache content.
+ * \param *libswdctx swd context to work on.
+ * \return number of pages dropped or LIBSWD_ERROR code on failure.
+ */
+int libswd_memcache_flush(libswd_ctx_t *libswdctx){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+
+ int i, n=0;
+
+ for (i=0; i<libswdctx->memcache.pagecount; i++)
+ {
+  if (!libswdctx->memcache.page[i].valid) continue;
+  libswdctx->memcache.page[i].valid=0;
+  n++;
+ }
+ libswdctx->memcache.invalidations+=n;
+ return n;
+}
+
+
+/** Invalidate MEM-AP read cache for memory that is about to be written.
+ * Writes to DHCSR or AIRCR may resume, step or reset the core, so they drop
+ * the whole cache and mark the core as not halted until it is seen halted.
+ * Writes to never cached peripherals drop the whole cache too, as they can
+ * change any memory (flash controller erase, DMA), core private peripherals
+ * from LIBSWD_MEMCACHE_PPB_ADDR up can not.
+ * \param *libswdctx swd context to work on.
+ * \param addr is the start address of the write.
+ * \param count is the number of bytes written.
+ * \return number of pages dropped or LIBSWD_ERROR code on failure.
+ */
+int libswd_memcache_invalidate(libswd_ctx_t *libswdctx, int addr, int count){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (count<=0) return 0;
+
+ int i, n=0;
+ libswd_memcache_page_t *page;
+
+ if ((unsigned int)(LIBSWD_ARM_DEBUG_DHCSR_ADDR-addr)<(unsigned int)count
+     || (unsigned int)(addr-LIBSWD_ARM_DEBUG_DHCSR_ADDR)<4)
+  libswdctx->log.debug.dhcsr&=~LIBSWD_ARM_DEBUG_DHCSR_SHALT;
+ if ((unsigned int)(LIBSWD_ARM_DEBUG_DHCSR_ADDR-addr)<(unsigned int)count
+     || (unsigned int)(addr-LIBSWD_ARM_DEBUG_DHCSR_ADDR)<4
+     || (unsigned int)(LIBSWD_ARM_DEBUG_AIRCR_ADDR-addr)<(unsigned int)count
+     || (unsigned int)(addr-LIBSWD_ARM_DEBUG_AIRCR_ADDR)<4)
+  return libswd_memcache_flush(libswdctx);
+ if ((unsigned int)addr<LIBSWD_MEMCACHE_PPB_ADDR
+     && libswd_memcache_region_policy(libswdctx, addr)==LIBSWD_MEMCACHE_POLICY_NEVER)
+  return libswd_memcache_flush(libswdctx);
+
+ for (i=0; i<libswdctx->memcache.pagecount; i++)
+ {
+  page=&libswdctx->memcache.page[i];
+  if (!page->valid) continue;
+  if ((unsigned int)(page->addr-addr)<(unsigned int)count
+      || (unsigned int)(addr-page->addr)<(unsigned int)libswdctx->memcache.pagesize)
+  {
+   page->valid=0;
+   n++;
+  }
+ }
+ libswdctx->memcache.invalidations+=n;
+ return n;
+}
+
+
+/** Read MEM-AP read cache page from target.
+ * \param *libswdctx swd context to work on.
+ * \param *page is the page to fill.
+ * \param addr is the page aligned address.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_memcache_fill(libswd_ctx_t *libswdctx, libswd_memcache_page_t *page, int addr){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (page==NULL) return LIBSWD_ERROR_NULLPOINTER;
+
+ int res, csw;
+
+ page->valid=0;
+ csw=libswdctx->log.memap.csw;
+ res=libswd_memap_setup(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_MEMAP_CSW_SIZE_32BIT|LIBSWD_MEMAP_CSW_ADDRINC_SINGLE, libswdctx->log.memap.tar);
+ if (res>=0) res=libswd_memap_read_block(libswdctx, addr, libswdctx->memcache.pagesize/4, (int*)page->data);
+ if (res>=0) libswd_memap_drw2image(libswdctx, (int*)page->data, libswdctx->memcache.pagesize/4, (char*)page->data);
+ if (res>=0) res=libswd_memap_setup(libswdctx, LIBSWD_OPERATION_EXECUTE, csw, libswdctx->log.memap.tar);
+ else libswd_memap_setup(libswdctx, LIBSWD_OPERATION_EXECUTE, csw, libswdctx->log.memap.tar);
+ if (res<0) return res;
+ page->ap=libswdctx->aptable.current;
+ page->addr=addr;
+ page->valid=1;
+ return LIBSWD_OK;
+}
+
+
+/** Serve MEM-AP read from the read cache.
+ * Whole range must be cacheable at the moment, missing pages are read from
+ * target with the least recently used pages replaced.
+ * \param *libswdctx swd context to work on.
+ * \param addr is the start address of the data to read.
+ * \param count is the number of bytes to read.
+ * \param *data is the pointer to char array where result will be stored.
+ * \return count if served from cache, 0 if range can not be cached, LIBSWD_ERROR code on failure.
+ */
+int libswd_memcache_read(libswd_ctx_t *libswdctx, int addr, int count, char *data){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (!libswdctx->memcache.pagecount || count<=0) return 0;
+ if (data==NULL) return LIBSWD_ERROR_NULLPOINTER;
+
+ int i, res, loc, first, last, len;
+ libswd_memcache_page_t *page, *victim;
+
+ first=addr&~(libswdctx->memcache.pagesize-1);
+ last=(addr+count-1)&~(libswdctx->memcache.pagesize-1);
+ for (loc=first; ; loc+=libswdctx->memcache.pagesize)
+ {
+  res=libswd_memcache_policy(libswdctx, loc);
+  if (res<=0) return res;
+  if (loc==last) break;
+ }
+
+ for (loc=first; ; loc+=libswdctx->memcache.pagesize)
+ {
+  page=NULL;
+  victim=&libswdctx->memcache.page[0];
+  for (i=0; i<libswdctx->memcache.pagecount; i++)
+  {
+   if (libswdctx->memcache.page[i].valid && libswdctx->memcache.page[i].addr==loc
+       && libswdctx->memcache.page[i].ap==libswdctx->aptable.current)
+   {
+    page=&libswdctx->memcache.page[i];
+    break;
+   }
+   if (victim->valid && (!libswdctx->memcache.page[i].valid || libswdctx->memcache.page[i].used<victim->used))
+    victim=&libswdctx->memcache.page[i];
+  }
+  if (page)
+  {
+   libswdctx->memcache.hits++;
+  }
+  else
+  {
+   libswdctx->memcache.misses++;
+   page=victim;
+   res=libswd_memcache_fill(libswdctx, page, loc);
+   if (res<0) return res;
+  }
+  page->used=++libswdctx->memcache.stamp;
+  // Copy the part of the page that overlaps the requested range.
+  i=(loc==first)?addr-loc:0;
+  len=libswdctx->memcache.pagesize-i;
+  if (len>count-(loc+i-addr)) len=count-(loc+i-addr);
+  memcpy((void*)(data+(loc+i-addr)), (void*)(page->data+i), len);
+  if (loc==last) break;
+ }
+ return count;
+}
+
+
 /** @} */
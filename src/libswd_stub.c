@@ -0,0 +1,420 @@
+/*
+ * Serial Wire Debug Open Library.
+ * On-Target Routines Body File.
+ *
+ * Copyright (C) 2013, Tomasz Boleslaw CEDRO (http://www.tomek.cedro.info)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the Tomasz Boleslaw CEDRO nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.*
+ *
+ * Written by Tomasz Boleslaw CEDRO <cederom@tlen.pl>, 2013;
+ *
+ */
+
+
+/** \file libswd_stub.c On-Target Routines (Stubs) Execution. */
+
+#include <libswd.h>
+
+/*******************************************************************************
+ * \defgroup libswd_stub Small routines uploaded to and executed on target.
+ * Operations that would need all the data to cross the wire (checksum, blank
+ * check, fill) are done by the core itself. Routine is loaded into the RAM
+ * work area set with libswd_stub_workarea(), arguments are passed in core
+ * registers, core is resumed and stops on BKPT with the result in R0.
+ * Core registers are saved before and restored after each run.
+ * @{
+ ******************************************************************************/
+
+/** Set target RAM work area for on-target routines.
+ * Work area holds the routine code and its stack, its content is destroyed.
+ * \param *libswdctx swd context to work on.
+ * \param addr is the work area address, word aligned.
+ * \param size is the work area size [bytes], 0 disables on-target routines.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_stub_workarea(libswd_ctx_t *libswdctx, int addr, int size){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (size<0 || (addr&3)) return LIBSWD_ERROR_PARAM;
+ libswdctx->config.stubaddr=addr;
+ libswdctx->config.stubsize=size;
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO,
+            "LIBSWD_I: libswd_stub_workarea(): Work area at 0x%08X, %d bytes.\n",
+            addr, size);
+ return LIBSWD_OK;
+}
+
+
+/** Execute routine on target and collect its result.
+ * Core is halted if necessary, its registers are saved, routine is written
+ * to the work area start, arguments go to R0..R3, SP is set to the work area
+ * end and core is resumed with interrupts masked until it halts on BKPT or
+ * config.stubtimeout expires. Core is left halted with registers restored.
+ * Memory read cache is flushed, as the routine may change target memory.
+ * \param *libswdctx swd context to work on.
+ * \param *stub is the routine to execute (ie. &libswd_stub_builtin[LIBSWD_STUB_CRC32]).
+ * \param *args is the array of routine arguments.
+ * \param nargs is the number of arguments, up to 4.
+ * \param *result if not NULL will hold R0 value after the routine.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_stub_run(libswd_ctx_t *libswdctx, const libswd_stub_t *stub, int *args, int nargs, int *result){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG,
+            "LIBSWD_D: Entering libswd_stub_run(*libswdctx=%p, *stub=%p, *args=%p, nargs=%d, *result=%p)...\n",
+            (void*)libswdctx, (void*)stub, (void*)args, nargs, (void*)result );
+
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (stub==NULL || stub->code==NULL) return LIBSWD_ERROR_NULLPOINTER;
+ if (nargs<0 || nargs>4 || (nargs && args==NULL)) return LIBSWD_ERROR_PARAM;
+
+ int i, res, retval, dhcsr, maskints, dfsr, regs[LIBSWD_ARM_REG_COUNT];
+
+ if (!libswdctx->config.stubsize || stub->size+LIBSWD_STUB_STACK>libswdctx->config.stubsize)
+ {
+  res=LIBSWD_ERROR_WORKAREA;
+  goto libswd_stub_run_error;
+ }
+ if (!libswdctx->log.debug.initialized)
+ {
+  res=libswd_debug_init(libswdctx, LIBSWD_OPERATION_EXECUTE);
+  if (res<0) goto libswd_stub_run_error;
+ }
+ // Registers are only accessible in debug state.
+ if (!libswd_debug_is_halted(libswdctx, LIBSWD_OPERATION_EXECUTE))
+ {
+  res=libswd_debug_halt(libswdctx, LIBSWD_OPERATION_EXECUTE);
+  if (res<0) goto libswd_stub_run_error;
+ }
+ maskints=libswdctx->log.debug.dhcsr&LIBSWD_ARM_DEBUG_DHCSR_CMASKINTS;
+ for (i=0; i<LIBSWD_ARM_REG_COUNT; i++)
+ {
+  res=libswd_debug_reg_read(libswdctx, i, &regs[i]);
+  if (res<0) goto libswd_stub_run_error;
+ }
+
+ res=libswd_memap_write_any(libswdctx, libswdctx->config.stubaddr, stub->size, (char*)stub->code);
+ for (i=0; i<nargs && res>=0; i++)
+  res=libswd_debug_reg_write(libswdctx, LIBSWD_ARM_REG_R0+i, args[i]);
+ if (res>=0) res=libswd_debug_reg_write(libswdctx, LIBSWD_ARM_REG_SP, (libswdctx->config.stubaddr+libswdctx->config.stubsize)&~7);
+ if (res>=0) res=libswd_debug_reg_write(libswdctx, LIBSWD_ARM_REG_PC, libswdctx->config.stubaddr);
+ if (res>=0) res=libswd_debug_reg_write(libswdctx, LIBSWD_ARM_REG_XPSR, LIBSWD_ARM_XPSR_T);
+ if (res<0) goto libswd_stub_run_restore;
+
+ // C_MASKINTS may only change while halted, so it is set before C_HALT is cleared.
+ dhcsr=LIBSWD_ARM_DEBUG_DHCSR_DBGKEY|LIBSWD_ARM_DEBUG_DHCSR_CDEBUGEN|LIBSWD_ARM_DEBUG_DHCSR_CMASKINTS|LIBSWD_ARM_DEBUG_DHCSR_CHALT;
+ res=libswd_memap_write_int_32(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_ARM_DEBUG_DHCSR_ADDR, 1, &dhcsr);
+ if (res<0) goto libswd_stub_run_restore;
+ dhcsr&=~LIBSWD_ARM_DEBUG_DHCSR_CHALT;
+ res=libswd_memap_write_int_32(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_ARM_DEBUG_DHCSR_ADDR, 1, &dhcsr);
+ if (res<0) goto libswd_stub_run_restore;
+ res=libswd_memap_poll(libswdctx, LIBSWD_ARM_DEBUG_DHCSR_ADDR, LIBSWD_ARM_DEBUG_DHCSR_SHALT, LIBSWD_ARM_DEBUG_DHCSR_SHALT, libswdctx->config.stubtimeout, LIBSWD_RETRY_DELAY_DEFAULT, &dhcsr);
+ if (res==LIBSWD_ERROR_TIMEOUT)
+ {
+  libswd_log(libswdctx, LIBSWD_LOGLEVEL_WARNING,
+             "LIBSWD_W: libswd_stub_run(): Routine \"%s\" did not finish, halting the core.\n",
+             stub->name );
+  retval=libswd_debug_halt(libswdctx, LIBSWD_OPERATION_EXECUTE);
+  if (retval<0)
+  {
+   res=retval;
+   goto libswd_stub_run_error;
+  }
+ }
+ else if (res>=0)
+ {
+  libswdctx->log.debug.dhcsr=dhcsr;
+  if (result) res=libswd_debug_reg_read(libswdctx, LIBSWD_ARM_REG_R0, result);
+ }
+ // Clear BKPT reason, DFSR is write-one-to-clear.
+ dfsr=LIBSWD_ARM_DEBUG_DFSR_BKPT|LIBSWD_ARM_DEBUG_DFSR_HALTED;
+ retval=libswd_memap_write_int_32(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_ARM_DEBUG_DFSR_ADDR, 1, &dfsr);
+ if (res>=0) res=retval;
+
+libswd_stub_run_restore:
+ // Caller's core state is restored even when routine failed.
+ for (i=0; i<LIBSWD_ARM_REG_COUNT; i++)
+ {
+  retval=libswd_debug_reg_write(libswdctx, i, regs[i]);
+  if (res>=0) res=retval;
+ }
+ dhcsr=LIBSWD_ARM_DEBUG_DHCSR_DBGKEY|LIBSWD_ARM_DEBUG_DHCSR_CDEBUGEN|LIBSWD_ARM_DEBUG_DHCSR_CHALT|maskints;
+ retval=libswd_memap_write_int_32(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_ARM_DEBUG_DHCSR_ADDR, 1, &dhcsr);
+ if (retval>=0) retval=libswd_memap_read_int_32(libswdctx, LIBSWD_OPERATION_EXECUTE, LIBSWD_ARM_DEBUG_DHCSR_ADDR, 1, &libswdctx->log.debug.dhcsr);
+ if (res>=0) res=retval;
+ if (res>=0) return LIBSWD_OK;
+
+libswd_stub_run_error:
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR,
+            "LIBSWD_E: libswd_stub_run(): %s\n",
+            libswd_error_string(res) );
+ return res;
+}
+
+
+/** Calculate CRC-32 of target memory on target.
+ * This is the zlib crc32() compatible checksum, so it can be compared with
+ * host side checksum of the image without reading the memory back.
+ * \param *libswdctx swd context to work on.
+ * \param addr is the start address of the region.
+ * \param count is the number of bytes in the region.
+ * \param *crc holds the checksum of previous data (0 to start) and will hold the result.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_stub_crc32(libswd_ctx_t *libswdctx, int addr, int count, unsigned int *crc){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (crc==NULL) return LIBSWD_ERROR_NULLPOINTER;
+ if (count<0) return LIBSWD_ERROR_PARAM;
+
+ int res, args[4];
+
+ args[0]=addr;
+ args[1]=count;
+ args[2]=(int)*crc;
+ args[3]=(int)LIBSWD_STUB_CRC32_POLY;
+ res=libswd_stub_run(libswdctx, &libswd_stub_builtin[LIBSWD_STUB_CRC32], args, 4, (int*)crc);
+ if (res<0) return res;
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO,
+            "LIBSWD_I: libswd_stub_crc32(): CRC32 of 0x%08X..0x%08X is 0x%08X.\n",
+            addr, addr+count, *crc );
+ return LIBSWD_OK;
+}
+
+
+/** Check on target that memory region holds only given byte value.
+ * \param *libswdctx swd context to work on.
+ * \param addr is the start address of the region.
+ * \param count is the number of bytes in the region.
+ * \param value is the blank byte value (ie. 0xFF for erased flash).
+ * \param *offset if not NULL will hold the offset of the first non blank byte (count when blank).
+ * \return LIBSWD_OK when region is blank, LIBSWD_ERROR_MISMATCH or other LIBSWD_ERROR code on failure.
+ */
+int libswd_stub_blank(libswd_ctx_t *libswdctx, int addr, int count, char value, int *offset){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (count<0) return LIBSWD_ERROR_PARAM;
+
+ int res, done, args[3];
+
+ args[0]=addr;
+ args[1]=count;
+ args[2]=value&0xFF;
+ res=libswd_stub_run(libswdctx, &libswd_stub_builtin[LIBSWD_STUB_BLANK], args, 3, &done);
+ if (res<0) return res;
+ if (offset) *offset=done;
+ if (done!=count)
+ {
+  libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO,
+             "LIBSWD_I: libswd_stub_blank(): Region not blank at 0x%08X.\n",
+             addr+done );
+  return LIBSWD_ERROR_MISMATCH;
+ }
+ return LIBSWD_OK;
+}
+
+
+/** Verify target memory against host image with on-target CRC-32.
+ * Only the routine and its result cross the wire, checksum of the image is
+ * calculated on host with libswd_bin_crc32(). Mismatch location is not
+ * known, read the region back and use libswd_bin_compare() to find it.
+ * \param *libswdctx swd context to work on.
+ * \param addr is the start address of the region.
+ * \param count is the number of bytes to verify.
+ * \param *data is the expected region content.
+ * \return LIBSWD_OK when memory matches, LIBSWD_ERROR_MISMATCH or other LIBSWD_ERROR code on failure.
+ */
+int libswd_stub_verify(libswd_ctx_t *libswdctx, int addr, int count, const char *data){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (data==NULL) return LIBSWD_ERROR_NULLPOINTER;
+ if (count<0) return LIBSWD_ERROR_PARAM;
+
+ int res;
+ unsigned int crc=0, expected;
+
+ expected=libswd_bin_crc32(0, data, count);
+ res=libswd_stub_crc32(libswdctx, addr, count, &crc);
+ if (res<0) return res;
+ if (crc!=expected)
+ {
+  libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO,
+             "LIBSWD_I: libswd_stub_verify(): CRC32 0x%08X, expected 0x%08X.\n",
+             crc, expected );
+  return LIBSWD_ERROR_MISMATCH;
+ }
+ return LIBSWD_OK;
+}
+
+
+/** Fill word aligned target memory region with a word on target.
+ * Work area must not overlap the region.
+ * \param *libswdctx swd context to work on.
+ * \param addr is the start address of the region, word aligned.
+ * \param count is the number of bytes to fill, multiple of 4.
+ * \param word is the value to fill memory with.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_stub_fill(libswd_ctx_t *libswdctx, int addr, int count, int word){
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (count<0) return LIBSWD_ERROR_PARAM;
+ if ((addr|count)&3) return LIBSWD_ERROR_MEMAPALIGN;
+
+ int args[3];
+
+ args[0]=addr;
+ args[1]=count;
+ args[2]=word;
+ return libswd_stub_run(libswdctx, &libswd_stub_builtin[LIBSWD_STUB_FILL], args, 3, NULL);
+}
+
+
+/** Decode PackBits style RLE stream of the on-target compressor.
+ * \param *in is the compressed stream.
+ * \param incount is the compressed stream size [bytes].
+ * \param *out is the output buffer.
+ * \param outcount is the output buffer size [bytes], it is never written past.
+ * \return number of bytes decoded, less than expected on damaged stream.
+ */
+int libswd_stub_rle_decode(const unsigned char *in, int incount, char *out, int outcount){
+ if (in==NULL || out==NULL) return LIBSWD_ERROR_NULLPOINTER;
+
+ int i=0, o=0, n;
+
+ while (i<incount)
+ {
+  if (in[i]<128)
+  {
+   n=in[i++]+1;
+   if (i+n>incount || o+n>outcount) break;
+   memcpy(out+o, in+i, n);
+   i+=n;
+  }
+  else
+  {
+   n=in[i++]-125;
+   if (i>=incount || o+n>outcount) break;
+   memset(out+o, in[i++], n);
+  }
+  o+=n;
+ }
+ return o;
+}
+
+
+/** Read target memory compressed on target.
+ * Region is split into chunks of the work area staging buffer size (work
+ * area less the routine and its stack), each chunk is compressed on target
+ * with the RLE routine, compressed data is read with libswd_memap_read_any()
+ * and decoded on host. Chunk that does not compress by at least
+ * 1/LIBSWD_STUB_RLE_GAIN is read plainly instead, so does the whole region
+ * when work area is not set, too small, or overlaps the region.
+ * Core is halted if necessary and left halted (see libswd_stub_run()).
+ * \param *libswdctx swd context to work on.
+ * \param addr is the start address of the region.
+ * \param count is the number of bytes to read.
+ * \param *data is the buffer for count bytes of target memory.
+ * \return LIBSWD_OK on success or LIBSWD_ERROR code on failure.
+ */
+int libswd_stub_read_rle(libswd_ctx_t *libswdctx, int addr, int count, char *data){
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG,
+            "LIBSWD_D: Entering libswd_stub_read_rle(*libswdctx=%p, addr=0x%08X, count=0x%08X, *data=%p)...\n",
+            (void*)libswdctx, addr, count, (void*)data );
+
+ if (libswdctx==NULL) return LIBSWD_ERROR_NULLCONTEXT;
+ if (data==NULL) return LIBSWD_ERROR_NULLPOINTER;
+ if (count<0) return LIBSWD_ERROR_PARAM;
+
+ const libswd_stub_t *stub=&libswd_stub_builtin[LIBSWD_STUB_RLE];
+ int i, n, res, packed, staging, size, args[4];
+ unsigned char *buf=NULL;
+
+ staging=libswdctx->config.stubaddr+((stub->size+3)&~3);
+ size=(libswdctx->config.stubsize-((stub->size+3)&~3)-LIBSWD_STUB_STACK)&~3;
+
+ libswd_stats_enter(libswdctx, LIBSWD_STATS_CLASS_MEMAP);
+ if (!libswdctx->config.stubsize || size<LIBSWD_STUB_RLE_MIN
+     || (unsigned int)(libswdctx->config.stubaddr-addr)<(unsigned int)count
+     || (unsigned int)(addr-libswdctx->config.stubaddr)<(unsigned int)libswdctx->config.stubsize)
+ {
+  libswd_log(libswdctx, LIBSWD_LOGLEVEL_INFO,
+             "LIBSWD_I: libswd_stub_read_rle(): No usable work area, reading plain.\n" );
+  res=libswd_memap_read_any(libswdctx, addr, count, data);
+  if (res>=0 && libswdctx->statsctl.depth[LIBSWD_STATS_CLASS_MEMAP]==1) libswdctx->stats.bytes+=count;
+  goto libswd_stub_read_rle_leave;
+ }
+ buf=(unsigned char*)malloc(size);
+ if (buf==NULL)
+ {
+  res=LIBSWD_ERROR_OUTOFMEM;
+  goto libswd_stub_read_rle_leave;
+ }
+
+ for (i=0; i<count; i+=n)
+ {
+  n=count-i;
+  if (n>size) n=size;
+  args[0]=addr+i;
+  args[1]=n;
+  args[2]=staging;
+  args[3]=staging+n-n/LIBSWD_STUB_RLE_GAIN;
+  res=libswd_stub_run(libswdctx, stub, args, 4, &packed);
+  if (res<0) goto libswd_stub_read_rle_leave;
+  if (packed>=0)
+  {
+   res=libswd_memap_read_any(libswdctx, staging, packed, (char*)buf);
+   if (res<0) goto libswd_stub_read_rle_leave;
+   if (libswd_stub_rle_decode(buf, packed, data+i, n)!=n)
+   {
+    libswd_log(libswdctx, LIBSWD_LOGLEVEL_WARNING,
+               "LIBSWD_W: libswd_stub_read_rle(): Damaged chunk at 0x%08X, reading plain.\n",
+               addr+i );
+    packed=-1;
+   }
+  }
+  if (packed<0)
+  {
+   // Chunk does not compress well, compressed data never crossed the wire.
+   res=libswd_memap_read_any(libswdctx, addr+i, n, data+i);
+   if (res<0) goto libswd_stub_read_rle_leave;
+  }
+  libswd_log(libswdctx, LIBSWD_LOGLEVEL_DEBUG,
+             "LIBSWD_D: libswd_stub_read_rle(): Chunk 0x%08X of %d bytes read as %d bytes.\n",
+             addr+i, n, packed<0?n:packed );
+  if (libswdctx->statsctl.depth[LIBSWD_STATS_CLASS_MEMAP]==1)
+  {
+   libswdctx->stats.bytes+=n;
+   libswd_stats_progress(libswdctx, i+n, count);
+  }
+ }
+ res=LIBSWD_OK;
+
+libswd_stub_read_rle_leave:
+ libswd_stats_leave(libswdctx, LIBSWD_STATS_CLASS_MEMAP);
+ if (buf) free(buf);
+ if (res>=0) return LIBSWD_OK;
+ libswd_log(libswdctx, LIBSWD_LOGLEVEL_ERROR,
+            "LIBSWD_E: libswd_stub_read_rle(): %s\n",
+            libswd_error_string(res) );
+ return res;
+}
+
+
+/** @} */